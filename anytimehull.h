@@ -0,0 +1,209 @@
+#pragma once
+
+/*
+Best-first (anytime) hull refinement, for callers that have a deadline and want the best hull they can get by then.
+
+step() and the coroutine stepper both go depth-first, so if they're stopped early one part of the hull is finished while the rest is still the first rough triangle.
+Here every unfinished edge of the hull so far waits in a priority queue instead, keyed by how far its points can be from the hull:
+the largest distance from any of them to the edge itself (the segment, not the line through it, since points past either end are further from it than from the line).
+Each refinement takes the edge that's furthest off, adds its furthest point from the line to the hull (the one Quickhull always splits on, found while splitting its parent)
+and queues the two new edges, so the hull gets better evenly all the way around.
+
+Every point that isn't known to be inside the hull belongs to exactly one unfinished edge, and the edge is part of the hull's boundary,
+so no point is further from the hull so far than the key on top of the queue. currentError() is the smallest that's been so far:
+the true distance only ever shrinks as the hull grows, so an earlier bound still holds later, and this way it never goes up. It's 0 once the hull is complete.
+Working out an edge's key takes one more pass over its points after they're split off.
+*/
+
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "point.h"
+#include "segmentclassifier.h"
+#include "executor.h"
+#include "hullengine.h"
+#include "stepper.h"
+#include "checkpoint.h"
+
+//one unfinished edge of the hull: the points right of segmentA->segmentB, sorted with pointLessThan, the one furthest from the line through it,
+//and how far the furthest of them is from the segment
+struct AnytimeEdge {
+	Point segmentA, segmentB;
+	Point furthest;
+	double error;
+	std::shared_ptr<PointList> pointSet;
+};
+
+//squared distance from p to the segment a-b
+inline double segmentDistanceSquared(Point a, Point b, Point p) {
+	double edgeX = (double)b.x - a.x, edgeY = (double)b.y - a.y;
+	double pointX = (double)p.x - a.x, pointY = (double)p.y - a.y;
+	double along = edgeX * pointX + edgeY * pointY;
+	double lengthSquared = edgeX * edgeX + edgeY * edgeY;
+	if (along <= 0) {
+		return pointX * pointX + pointY * pointY;
+	}
+	if (along >= lengthSquared) {
+		double endX = (double)p.x - b.x, endY = (double)p.y - b.y;
+		return endX * endX + endY * endY;
+	}
+	double cross = (double)SegmentClassifier(a, b).side(p);
+	return cross * cross / lengthSquared;
+}
+
+class AnytimeHull {
+private:
+	//a heap with the edge that's furthest off on top
+	std::vector<AnytimeEdge> pending;
+	std::vector<Point> hullPoints;
+
+	//the smallest bound the top of the heap has given so far
+	double errorBound = 0;
+
+	//the last refined edge's points and the two sets they were split into, kept alive for event()
+	std::shared_ptr<PointList> lastSet, lastOne, lastTwo;
+	StepEvent lastEvent;
+
+	static bool lessError(const AnytimeEdge& left, const AnytimeEdge& right) {
+		return left.error < right.error;
+	}
+
+	void push(Executor& exec, Point segmentA, Point segmentB, Point furthest, std::shared_ptr<PointList> pointSet) {
+		if (pointSet->empty()) {
+			return;
+		}
+
+		//the furthest any of the points is from the edge
+		const PointList& points = *pointSet;
+		size_t count = points.size();
+		size_t chunks = exec.chunkCount(count, engineGrainSize);
+		std::vector<double> chunkFurthest(chunks, 0);
+		exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+			for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+				size_t begin, end;
+				chunkBounds(count, chunks, chunk, begin, end);
+				double furthestSquared = 0;
+				for (size_t x = begin; x < end; x++) {
+					furthestSquared = std::max(furthestSquared, segmentDistanceSquared(segmentA, segmentB, points[x]));
+				}
+				chunkFurthest[chunk] = furthestSquared;
+			}
+			});
+		double error = std::sqrt(*std::max_element(chunkFurthest.begin(), chunkFurthest.end()));
+
+		pending.push_back(AnytimeEdge{ segmentA, segmentB, furthest, error, std::move(pointSet) });
+		std::push_heap(pending.begin(), pending.end(), lessError);
+	}
+
+	void updateErrorBound() {
+		errorBound = std::min(errorBound, pending.empty() ? 0 : pending.front().error);
+	}
+
+public:
+	//starts over on a list sorted with pointLessThan. the leftmost and rightmost points are on the hull straight away.
+	void start(Executor& exec, PointList sortedPoints) {
+		pending.clear();
+		hullPoints.clear();
+		errorBound = 0;
+		if (sortedPoints.empty()) {
+			return;
+		}
+		Point minPoint = sortedPoints[0];
+		Point maxPoint = sortedPoints[sortedPoints.size() - 1];
+		hullPoints.push_back(minPoint);
+		if (comparePoints(minPoint, maxPoint)) {
+			return;
+		}
+		hullPoints.push_back(maxPoint);
+
+		std::shared_ptr<PointList> upperSet = std::make_shared<PointList>(), lowerSet = std::make_shared<PointList>();
+		Point upperFurthest, lowerFurthest;
+		partitionAroundPoint(exec, minPoint, minPoint, maxPoint, sortedPoints, *upperSet, *lowerSet, upperFurthest, lowerFurthest);
+		push(exec, minPoint, maxPoint, upperFurthest, std::move(upperSet));
+		push(exec, maxPoint, minPoint, lowerFurthest, std::move(lowerSet));
+		errorBound = pending.empty() ? 0 : pending.front().error;
+	}
+
+	//picks up from a checkpoint (see checkpoint.h). the furthest point of every saved edge has to be found again.
+	void resume(Executor& exec, const HullCheckpoint& checkpoint) {
+		pending.clear();
+		hullPoints = checkpoint.hullPoints;
+		for (const CheckpointStep& step : checkpoint.steps) {
+			std::shared_ptr<PointList> pointSet = std::make_shared<PointList>(step.pointSet);
+			Point furthest = findFurthestPoint(exec, step.segmentA, step.segmentB, *pointSet);
+			push(exec, step.segmentA, step.segmentB, furthest, std::move(pointSet));
+		}
+		errorBound = pending.empty() ? 0 : pending.front().error;
+	}
+
+	//the hull so far and every unfinished edge, for saving to a checkpoint file
+	HullCheckpoint checkpoint() const {
+		HullCheckpoint saved;
+		saved.hullPoints = hullPoints;
+		for (const AnytimeEdge& edge : pending) {
+			saved.steps.push_back(CheckpointStep{ edge.segmentA, edge.segmentB, *edge.pointSet });
+		}
+		return saved;
+	}
+
+	//adds one point to the hull, from the edge that's furthest off. returns false once the hull is complete.
+	bool refine(Executor& exec) {
+		if (pending.empty()) {
+			return false;
+		}
+		std::pop_heap(pending.begin(), pending.end(), lessError);
+		AnytimeEdge edge = std::move(pending.back());
+		pending.pop_back();
+		hullPoints.push_back(edge.furthest);
+
+		lastSet = std::move(edge.pointSet);
+		lastOne = std::make_shared<PointList>();
+		lastTwo = std::make_shared<PointList>();
+		Point furthestOne, furthestTwo;
+		partitionAroundPoint(exec, edge.segmentA, edge.segmentB, edge.furthest, *lastSet, *lastOne, *lastTwo, furthestOne, furthestTwo);
+
+		lastEvent.furthest = edge.furthest;
+		lastEvent.minPoint = (*lastSet)[0];
+		lastEvent.maxPoint = (*lastSet)[lastSet->size() - 1];
+		lastEvent.pointSet = lastSet.get();
+		lastEvent.setOne = lastOne.get();
+		lastEvent.setTwo = lastTwo.get();
+
+		push(exec, edge.segmentA, edge.furthest, furthestOne, lastOne);
+		push(exec, edge.furthest, edge.segmentB, furthestTwo, lastTwo);
+		updateErrorBound();
+		return true;
+	}
+
+	//refines until the hull is complete or the deadline passes, whichever comes first. returns how many points were added.
+	size_t refineUntil(Executor& exec, std::chrono::steady_clock::time_point deadline) {
+		size_t steps = 0;
+		while (!pending.empty() && std::chrono::steady_clock::now() < deadline) {
+			refine(exec);
+			steps++;
+		}
+		return steps;
+	}
+
+	//no point is further than this from the hull so far, so the finished hull can't reach further past it anywhere
+	double currentError() const {
+		return errorBound;
+	}
+
+	bool done() const {
+		return pending.empty();
+	}
+
+	//the hull points found so far, unordered (see orderHull)
+	const std::vector<Point>& getHullPoints() const {
+		return hullPoints;
+	}
+
+	//what the last call to refine() did, in the same form the coroutine stepper reports it. only valid until the next refine().
+	const StepEvent& event() const {
+		return lastEvent;
+	}
+};
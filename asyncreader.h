@@ -0,0 +1,463 @@
+#pragma once
+
+/*
+A file reader that keeps several reads in flight at once, so the disk is never left idle while the data that already came in is being parsed.
+
+On Linux it uses io_uring, set up straight through the system calls so nothing extra has to be installed.
+Reads go into a fixed set of buffers that are registered with the kernel once, up front, so it doesn't have to map them again for every read.
+Up to asyncReadDepth blocks are queued at a time. Blocks are handed to the caller strictly in file order as they complete,
+and each buffer is queued again for a later block as soon as the caller is done with it, so parsing one block overlaps with reading the next few.
+
+Where io_uring isn't there (older kernels, containers that block it, other systems), the same interface falls back to plain pread calls, one block at a time.
+
+loadPointFileAsync and loadTextPointsAsync use it to load point files and "x,y" text files without a memory mapping.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <new>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+
+#include "point.h"
+#include "pointfile.h"
+#include "pointstream.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <cerrno>
+#define ASYNC_READER_IO_URING 1
+#else
+#define ASYNC_READER_IO_URING 0
+#endif
+
+//reads in flight at once
+const uint32_t asyncReadDepth = 8;
+
+//size of each read. big enough that the time per read is all transfer, and a multiple of the page size.
+const size_t asyncReadBlockSize = 1 << 20;
+
+const size_t asyncReadAlignment = 4096;
+
+class AsyncFileReader {
+private:
+	uint32_t depth;
+	size_t blockSize;
+	std::vector<char*> buffers;
+
+#if ASYNC_READER_IO_URING == 1
+	int ring = -1;
+	bool buffersRegistered = false;
+	std::vector<iovec> bufferVectors;
+
+	void* sqMemory = MAP_FAILED;
+	void* cqMemory = MAP_FAILED;
+	void* sqeMemory = MAP_FAILED;
+	size_t sqMemorySize = 0, cqMemorySize = 0, sqeMemorySize = 0;
+
+	unsigned *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+	unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+	io_uring_sqe* sqes = nullptr;
+	io_uring_cqe* cqes = nullptr;
+
+	//result of each buffer's read, once it's come back
+	std::vector<int> results;
+	std::vector<bool> completed;
+
+	//reads sent to the kernel that haven't come back yet
+	unsigned pending = 0;
+
+	bool setupRing() {
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		ring = (int)syscall(__NR_io_uring_setup, depth, &params);
+		if (ring < 0) {
+			return false;
+		}
+
+		sqMemorySize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqMemorySize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (singleMapping) {
+			sqMemorySize = cqMemorySize = std::max(sqMemorySize, cqMemorySize);
+		}
+		sqMemory = mmap(nullptr, sqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+		if (sqMemory == MAP_FAILED) {
+			return false;
+		}
+		cqMemory = singleMapping ? sqMemory : mmap(nullptr, cqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+		if (cqMemory == MAP_FAILED) {
+			return false;
+		}
+		sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+		sqeMemory = mmap(nullptr, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+		if (sqeMemory == MAP_FAILED) {
+			return false;
+		}
+
+		char* sq = (char*)sqMemory;
+		char* cq = (char*)cqMemory;
+		sqTail = (unsigned*)(sq + params.sq_off.tail);
+		sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+		sqArray = (unsigned*)(sq + params.sq_off.array);
+		cqHead = (unsigned*)(cq + params.cq_off.head);
+		cqTail = (unsigned*)(cq + params.cq_off.tail);
+		cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+		sqes = (io_uring_sqe*)sqeMemory;
+		cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+		//registering can fail if it's over the locked memory limit, in which case plain reads into the same buffers still work
+		bufferVectors.resize(depth);
+		for (uint32_t x = 0; x < depth; x++) {
+			bufferVectors[x].iov_base = buffers[x];
+			bufferVectors[x].iov_len = blockSize;
+		}
+		buffersRegistered = syscall(__NR_io_uring_register, ring, IORING_REGISTER_BUFFERS, bufferVectors.data(), depth) == 0;
+
+		results.assign(depth, 0);
+		completed.assign(depth, false);
+		return true;
+	}
+
+	void closeRing() {
+		if (sqeMemory != MAP_FAILED) {
+			munmap(sqeMemory, sqeMemorySize);
+		}
+		if (cqMemory != MAP_FAILED && cqMemory != sqMemory) {
+			munmap(cqMemory, cqMemorySize);
+		}
+		if (sqMemory != MAP_FAILED) {
+			munmap(sqMemory, sqMemorySize);
+		}
+		if (ring >= 0) {
+			::close(ring);
+		}
+		sqMemory = cqMemory = sqeMemory = MAP_FAILED;
+		ring = -1;
+	}
+
+	//queues a read of length bytes at offset into buffer slot. it isn't sent to the kernel until submit().
+	void queueRead(int file, uint32_t slot, uint64_t offset, uint32_t length) {
+		unsigned tail = *sqTail;
+		unsigned index = tail & *sqMask;
+		io_uring_sqe& entry = sqes[index];
+		memset(&entry, 0, sizeof(entry));
+		entry.fd = file;
+		entry.off = offset;
+		entry.user_data = slot;
+		if (buffersRegistered) {
+			entry.opcode = IORING_OP_READ_FIXED;
+			entry.addr = (uint64_t)(uintptr_t)buffers[slot];
+			entry.len = length;
+			entry.buf_index = (uint16_t)slot;
+		}
+		else {
+			bufferVectors[slot].iov_len = length;
+			entry.opcode = IORING_OP_READV;
+			entry.addr = (uint64_t)(uintptr_t)&bufferVectors[slot];
+			entry.len = 1;
+		}
+		sqArray[index] = index;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		completed[slot] = false;
+		pending++;
+	}
+
+	//sends queued reads, and if wait is set, blocks until at least one read has completed. returns false on an error.
+	bool submit(unsigned count, bool wait) {
+		while (true) {
+			long result = syscall(__NR_io_uring_enter, ring, count, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (result >= 0) {
+				return true;
+			}
+			if (errno != EINTR && errno != EAGAIN) {
+				return false;
+			}
+		}
+	}
+
+	//marks every read that has come back as completed
+	void reap() {
+		unsigned head = *cqHead;
+		unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+		while (head != tail) {
+			const io_uring_cqe& entry = cqes[head & *cqMask];
+			results[entry.user_data] = entry.res;
+			completed[entry.user_data] = true;
+			pending--;
+			head++;
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	template<class Callback>
+	bool readRing(int file, uint64_t offset, uint64_t size, Callback& onBlock) {
+		uint64_t blockCount = (size + blockSize - 1) / blockSize;
+		auto blockLength = [&](uint64_t block) {
+			return (uint32_t)std::min<uint64_t>(blockSize, size - block * blockSize);
+		};
+
+		//block b always goes into buffer b % depth, so the next block to hand over is always in a known place
+		uint64_t nextToQueue = 0;
+		unsigned queued = 0;
+		while (nextToQueue < blockCount && nextToQueue < depth) {
+			queueRead(file, (uint32_t)(nextToQueue % depth), offset + nextToQueue * blockSize, blockLength(nextToQueue));
+			nextToQueue++;
+			queued++;
+		}
+		if (!submit(queued, false)) {
+			return false;
+		}
+
+		bool failed = false;
+		for (uint64_t block = 0; block < blockCount && !failed; block++) {
+			uint32_t slot = (uint32_t)(block % depth);
+			while (!completed[slot]) {
+				if (!submit(0, true)) {
+					return false;
+				}
+				reap();
+			}
+
+			//a read that comes back short (a signal, or a file that shrank) is finished off with pread
+			uint32_t length = blockLength(block);
+			int result = results[slot];
+			if (result < 0) {
+				failed = true;
+				break;
+			}
+			while ((uint32_t)result < length) {
+				ssize_t more = pread(file, buffers[slot] + result, length - result, offset + block * blockSize + result);
+				if (more <= 0) {
+					failed = true;
+					break;
+				}
+				result += (int)more;
+			}
+			if (failed) {
+				break;
+			}
+
+			onBlock(buffers[slot], (size_t)length);
+
+			if (nextToQueue < blockCount) {
+				queueRead(file, slot, offset + nextToQueue * blockSize, blockLength(nextToQueue));
+				nextToQueue++;
+				if (!submit(1, false)) {
+					return false;
+				}
+			}
+		}
+
+		//buffers still being written to by the kernel can't be reused until their reads are done
+		while (pending > 0) {
+			if (!submit(0, true)) {
+				return false;
+			}
+			reap();
+		}
+		return !failed;
+	}
+#endif
+
+	template<class Callback>
+	bool readFallback(const std::string& path, uint64_t offset, uint64_t size, Callback& onBlock) {
+#if defined(_WIN32)
+		std::ifstream infile(path, std::ios::binary);
+		if (!infile.is_open() || !infile.seekg(offset)) {
+			return false;
+		}
+		for (uint64_t done = 0; done < size;) {
+			size_t length = (size_t)std::min<uint64_t>(blockSize, size - done);
+			if (!infile.read(buffers[0], length)) {
+				return false;
+			}
+			onBlock(buffers[0], length);
+			done += length;
+		}
+		return true;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		bool ok = true;
+		for (uint64_t done = 0; done < size && ok;) {
+			size_t length = (size_t)std::min<uint64_t>(blockSize, size - done);
+			size_t filled = 0;
+			while (filled < length) {
+				ssize_t result = pread(file, buffers[0] + filled, length - filled, offset + done + filled);
+				if (result <= 0) {
+					ok = false;
+					break;
+				}
+				filled += (size_t)result;
+			}
+			if (ok) {
+				onBlock(buffers[0], length);
+				done += length;
+			}
+		}
+		::close(file);
+		return ok;
+#endif
+	}
+
+public:
+	AsyncFileReader(uint32_t readDepth = asyncReadDepth, size_t readBlockSize = asyncReadBlockSize) : depth(readDepth), blockSize(readBlockSize) {
+		for (uint32_t x = 0; x < depth; x++) {
+			buffers.push_back((char*)::operator new(blockSize, std::align_val_t(asyncReadAlignment)));
+		}
+#if ASYNC_READER_IO_URING == 1
+		if (!setupRing()) {
+			closeRing();
+		}
+#endif
+	}
+
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	~AsyncFileReader() {
+#if ASYNC_READER_IO_URING == 1
+		closeRing();
+#endif
+		for (char* buffer : buffers) {
+			::operator delete(buffer, std::align_val_t(asyncReadAlignment));
+		}
+	}
+
+	//false if reads go through the pread fallback
+	bool usingIoUring() const {
+#if ASYNC_READER_IO_URING == 1
+		return ring >= 0;
+#else
+		return false;
+#endif
+	}
+
+	const char* name() const {
+#if ASYNC_READER_IO_URING == 1
+		if (ring >= 0) {
+			return buffersRegistered ? "io_uring (registered buffers)" : "io_uring";
+		}
+#endif
+		return "pread";
+	}
+
+	//reads size bytes from offset, calling onBlock(const char* data, size_t bytes) for each block in file order.
+	//the data is only valid during the call. returns false if the file can't be opened or has fewer bytes than asked for.
+	template<class Callback>
+	bool read(const std::string& path, uint64_t offset, uint64_t size, Callback onBlock) {
+		if (size == 0) {
+			return true;
+		}
+#if ASYNC_READER_IO_URING == 1
+		if (ring >= 0) {
+			int file = ::open(path.c_str(), O_RDONLY);
+			if (file < 0) {
+				return false;
+			}
+			bool ok = readRing(file, offset, size, onBlock);
+			::close(file);
+
+			//if the ring itself broke, reads still in it could land in the buffers later, so it's not used again
+			if (pending > 0) {
+				closeRing();
+			}
+			return ok;
+		}
+#endif
+		return readFallback(path, offset, size, onBlock);
+	}
+};
+
+//size of a file in bytes, or false if it can't be found
+inline bool asyncFileSize(const std::string& path, uint64_t& size) {
+	std::error_code error;
+	size = (uint64_t)std::filesystem::file_size(path, error);
+	return !error;
+}
+
+//loads a point file (see pointfile.h) by reading it rather than mapping it. the columns are split into points as each block arrives.
+//returns false if it can't be read, isn't a valid point file, or has a point outside the engine's range (see pointInRange() in segmentclassifier.h).
+inline bool loadPointFileAsync(AsyncFileReader& reader, const std::string& path, PointList& points) {
+	uint64_t fileSize;
+	PointFileHeader header;
+	if (!asyncFileSize(path, fileSize) || fileSize < sizeof(header)) {
+		return false;
+	}
+	if (!reader.read(path, 0, sizeof(header), [&](const char* data, size_t bytes) { memcpy(&header, data, bytes); })) {
+		return false;
+	}
+	if (!validPointFileHeader(header, fileSize)) {
+		return false;
+	}
+
+	//the two columns sit next to each other, so they're read as one range and each block is split between them
+	uint64_t columnBytes = header.pointCount * sizeof(int32_t);
+	uint64_t begin = std::min(header.xOffset, header.yOffset);
+	uint64_t end = std::max(header.xOffset, header.yOffset) + columnBytes;
+	points.resize((size_t)header.pointCount);
+
+	uint64_t position = begin;
+	bool inRange = true;
+	bool read = reader.read(path, begin, end - begin, [&](const char* data, size_t bytes) {
+		//copies the part of this block that overlaps a column into x or y of the matching points
+		auto fillColumn = [&](uint64_t columnOffset, bool isX) {
+			uint64_t from = std::max(position, columnOffset);
+			uint64_t to = std::min(position + bytes, columnOffset + columnBytes);
+			if (from >= to) {
+				return;
+			}
+			const char* in = data + (from - position);
+			size_t first = (size_t)((from - columnOffset) / sizeof(int32_t));
+			size_t count = (size_t)((to - from) / sizeof(int32_t));
+			for (size_t x = 0; x < count; x++) {
+				int32_t value;
+				memcpy(&value, in + x * sizeof(int32_t), sizeof(value));
+				inRange &= value >= -pointCoordinateLimit && value <= pointCoordinateLimit;
+				if (isX) {
+					points[first + x].x = value;
+				}
+				else {
+					points[first + x].y = value;
+				}
+			}
+		};
+		fillColumn(header.xOffset, true);
+		fillColumn(header.yOffset, false);
+		position += bytes;
+		});
+	return read && inRange;
+}
+
+//loads "x,y" text (see pointstream.h), parsing each block as it arrives. skippedLines, if given, is set to the amount of lines that weren't points or were out of range.
+inline bool loadTextPointsAsync(AsyncFileReader& reader, const std::string& path, PointList& points, size_t* skippedLines = nullptr) {
+	uint64_t fileSize;
+	if (!asyncFileSize(path, fileSize)) {
+		return false;
+	}
+	PointTextParser parser;
+	if (!reader.read(path, 0, fileSize, [&](const char* data, size_t bytes) { parser.feed(data, bytes, points); })) {
+		return false;
+	}
+	parser.finish(points);
+	if (skippedLines != nullptr) {
+		*skippedLines = parser.skippedLines();
+	}
+	return true;
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+/*
+Batch mode: works out the hull of every point file in a directory (or listed in a manifest) and writes each one out, for jobs over thousands of files at a time.
+	quickhull --batch inputs/ hulls/
+	quickhull --batch manifest.txt hulls/
+A manifest is a text file with one input path per line (blank lines and lines starting with # are skipped). Relative paths are taken from the manifest's folder.
+
+Inputs can be point files (see pointfile.h), compressed point files (see compressedpoints.h) or text with one "x,y" point per line, told apart by their first bytes.
+Each hull is written, in order, in the same "x,y" format as points.txt, to the output folder under the input's file name with ".txt" added.
+Inputs with the same file name (from different folders in a manifest) get a number added to all but the first one's name, "<name>.2.txt" and so on, so no hull is written over another.
+
+The work is split into three stages joined by bounded queues, so reading, computing and writing all overlap:
+	reader threads load and parse the files (through asyncreader.h, so each file has several reads in flight),
+	compute threads sort each one and run the hull engine on it (one file per thread, since a batch is usually many files rather than one huge one),
+	and writer threads write the results.
+With a hull cache (see hullcache.h), the compute threads look every input up before sorting it and store the hulls they had to work out.
+The queues only hold a few files each, so a fast stage waits for a slow one instead of filling up memory.
+
+Each stage keeps track of how long its threads spent working, waiting for input (starved) and waiting for room in the next queue (blocked).
+The report at the end shows those as a share of the run, so the stage that's busy nearly all the time, while the others are starved, is the bottleneck.
+*/
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <cctype>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+
+#include "point.h"
+#include "executor.h"
+#include "hullengine.h"
+#include "pointfile.h"
+#include "compressedpoints.h"
+#include "pointstream.h"
+#include "boundedqueue.h"
+#include "asyncreader.h"
+#include "hullcache.h"
+
+//threads for each stage. 0 compute threads means one per core.
+const size_t batchReadThreads = 2;
+const size_t batchComputeThreads = 0;
+const size_t batchWriteThreads = 1;
+
+//files each queue can hold before the stage filling it has to wait
+const size_t batchQueueFiles = 16;
+
+const char* const batchDefaultOutputDirectory = "hull_output";
+
+//one input file on its way through the stages
+struct BatchJob {
+	size_t index = 0;
+	std::filesystem::path path;
+	PointList points;
+	std::vector<Point> hull;
+	bool failed = false;
+};
+
+//time spent by every thread of one stage, in nanoseconds
+struct BatchStageStats {
+	const char* name;
+	size_t threads = 0;
+	std::atomic<uint64_t> items{ 0 };
+	std::atomic<uint64_t> busy{ 0 };
+	std::atomic<uint64_t> starved{ 0 };
+	std::atomic<uint64_t> blocked{ 0 };
+
+	BatchStageStats(const char* stageName) : name(stageName) {}
+};
+
+//adds the time since start to total, and restarts the clock
+inline void batchAddTime(std::atomic<uint64_t>& total, std::chrono::steady_clock::time_point& start) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	total += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+	start = now;
+}
+
+//the files to go through: every regular file in a directory, sorted by name, or every path listed in a manifest
+inline bool listBatchInputs(const std::string& input, std::vector<std::filesystem::path>& paths) {
+	std::error_code error;
+	if (std::filesystem::is_directory(input, error)) {
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(input, error)) {
+			if (entry.is_regular_file(error)) {
+				paths.push_back(entry.path());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+		return !error;
+	}
+
+	std::ifstream manifest(input);
+	if (!manifest.is_open()) {
+		return false;
+	}
+	std::filesystem::path folder = std::filesystem::path(input).parent_path();
+	std::string line;
+	while (std::getline(manifest, line)) {
+		while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+			line.pop_back();
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::filesystem::path path = line;
+		paths.push_back(path.is_relative() ? folder / path : path);
+	}
+	return true;
+}
+
+//the name each input's hull is written under, in the same order as paths. names are compared ignoring case, since they'd clash on a case-insensitive file system.
+inline std::vector<std::filesystem::path> batchOutputNames(const std::vector<std::filesystem::path>& paths, size_t& renamed) {
+	std::vector<std::filesystem::path> names;
+	std::unordered_set<std::string> taken;
+	auto take = [&](const std::string& name) {
+		std::string folded = name;
+		std::transform(folded.begin(), folded.end(), folded.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		return taken.insert(folded).second;
+	};
+
+	renamed = 0;
+	for (const std::filesystem::path& path : paths) {
+		std::string fileName = path.filename().string();
+		std::string name = fileName + ".txt";
+		for (size_t number = 2; !take(name); number++) {
+			name = fileName + "." + std::to_string(number) + ".txt";
+		}
+		if (name != fileName + ".txt") {
+			renamed++;
+		}
+		names.push_back(name);
+	}
+	return names;
+}
+
+//loads a point file, compressed point file or text file, telling them apart by their first bytes.
+//returns false if it can't be read, or if a point file or compressed file has a point outside the engine's range (text just skips those lines).
+inline bool loadBatchInput(const std::filesystem::path& path, PointList& points) {
+	SequentialExecutor exec;
+	char magic[8] = {};
+	{
+		std::ifstream infile(path, std::ios::binary);
+		if (!infile.is_open()) {
+			return false;
+		}
+		infile.read(magic, sizeof(magic));
+	}
+
+	//each reader thread keeps its own io_uring reader (see asyncreader.h), so every file is read with several reads in flight
+	thread_local AsyncFileReader reader;
+	if (memcmp(magic, pointFileMagic, sizeof(magic)) == 0) {
+		return loadPointFileAsync(reader, path.string(), points);
+	}
+	if (memcmp(magic, compressedFileMagic, sizeof(magic)) == 0) {
+		CompressedPointList compressed;
+		if (!compressed.load(path.string())) {
+			return false;
+		}
+		points = compressed.decompress(exec);
+
+		//point files and text are checked as they're read, but compressed lists can only be checked once they're decoded
+		return std::all_of(points.begin(), points.end(), pointInRange);
+	}
+
+	return loadTextPointsAsync(reader, path.string(), points);
+}
+
+inline void printBatchStage(const BatchStageStats& stage, double wallNanoseconds) {
+	double available = wallNanoseconds * stage.threads;
+	printf("%-10s %8zu %10llu %8.1f%% %8.1f%% %8.1f%%\n", stage.name, stage.threads, (unsigned long long)stage.items.load(),
+		100.0 * stage.busy / available, 100.0 * stage.starved / available, 100.0 * stage.blocked / available);
+}
+
+//hulls every input into outputDirectory, and prints how long it took and how busy each stage was. returns the program's exit code.
+//cache, if given, is shared by all the compute threads.
+inline int runBatch(const std::string& input, const std::string& outputDirectory, HullCache* cache = nullptr) {
+	std::vector<std::filesystem::path> paths;
+	if (!listBatchInputs(input, paths)) {
+		printf("Error: Unable to read %s\n", input.c_str());
+		return 1;
+	}
+	size_t renamed;
+	std::vector<std::filesystem::path> outputNames = batchOutputNames(paths, renamed);
+	if (renamed > 0) {
+		printf("%zu inputs share a file name with an earlier one, so their hulls have a number added to the name\n", renamed);
+	}
+	std::error_code error;
+	std::filesystem::create_directories(outputDirectory, error);
+	if (error) {
+		printf("Error: Unable to create %s\n", outputDirectory.c_str());
+		return 1;
+	}
+
+	BatchStageStats readStage("read"), computeStage("compute"), writeStage("write");
+	readStage.threads = batchReadThreads;
+	computeStage.threads = batchComputeThreads > 0 ? batchComputeThreads : std::max(1u, std::thread::hardware_concurrency());
+	writeStage.threads = batchWriteThreads;
+
+	BoundedQueue<BatchJob> loaded(batchQueueFiles), computed(batchQueueFiles);
+	std::atomic<size_t> nextPath{ 0 };
+	std::atomic<size_t> failedFiles{ 0 };
+	std::atomic<uint64_t> totalPoints{ 0 };
+	std::atomic<size_t> readersLeft{ readStage.threads }, computersLeft{ computeStage.threads };
+
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+
+	for (size_t x = 0; x < readStage.threads; x++) {
+		threads.emplace_back([&]() {
+			std::chrono::steady_clock::time_point clock = std::chrono::steady_clock::now();
+			size_t index;
+			while ((index = nextPath++) < paths.size()) {
+				BatchJob job;
+				job.index = index;
+				job.path = paths[index];
+				job.failed = !loadBatchInput(job.path, job.points) || job.points.empty();
+				totalPoints += job.points.size();
+				readStage.items++;
+				batchAddTime(readStage.busy, clock);
+
+				loaded.push(std::move(job));
+				batchAddTime(readStage.blocked, clock);
+			}
+			if (--readersLeft == 0) {
+				loaded.close();
+			}
+			});
+	}
+
+	for (size_t x = 0; x < computeStage.threads; x++) {
+		threads.emplace_back([&]() {
+			SequentialExecutor exec;
+			std::chrono::steady_clock::time_point clock = std::chrono::steady_clock::now();
+			BatchJob job;
+			while (loaded.pop(job)) {
+				batchAddTime(computeStage.starved, clock);
+				//keyed on the points as they were read, so it's checked before they're sorted
+				uint64_t cacheKey = 0;
+				if (!job.failed && cache) {
+					cacheKey = cache->key(job.points);
+				}
+				if (!job.failed && !(cache && cache->lookup(cacheKey, job.points.size(), job.hull))) {
+					std::sort(job.points.begin(), job.points.end(), pointLessThan);
+					job.hull = orderHull(computeHullPoints(exec, job.points));
+					if (cache) {
+						cache->store(cacheKey, job.points.size(), job.hull);
+					}
+				}
+				job.points = PointList();
+				computeStage.items++;
+				batchAddTime(computeStage.busy, clock);
+
+				computed.push(std::move(job));
+				batchAddTime(computeStage.blocked, clock);
+			}
+			batchAddTime(computeStage.starved, clock);
+			if (--computersLeft == 0) {
+				computed.close();
+			}
+			});
+	}
+
+	for (size_t x = 0; x < writeStage.threads; x++) {
+		threads.emplace_back([&]() {
+			std::chrono::steady_clock::time_point clock = std::chrono::steady_clock::now();
+			BatchJob job;
+			while (computed.pop(job)) {
+				batchAddTime(writeStage.starved, clock);
+				std::filesystem::path outputPath = std::filesystem::path(outputDirectory) / outputNames[job.index];
+				std::ofstream outfile;
+				if (!job.failed) {
+					outfile.open(outputPath);
+					writeHullPoints(outfile, job.hull);
+					outfile.flush();
+				}
+				if (job.failed || !outfile.good()) {
+					failedFiles++;
+					fprintf(stderr, "Error: Unable to %s %s\n", job.failed ? "load" : "write the hull of", job.path.string().c_str());
+				}
+				writeStage.items++;
+				batchAddTime(writeStage.busy, clock);
+			}
+			batchAddTime(writeStage.starved, clock);
+			});
+	}
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	double wall = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - runStart).count();
+
+	printf("%zu files (%zu failed), %llu points in %.3f s: %.1f files/s, %.2f million points/s\n", paths.size(), failedFiles.load(),
+		(unsigned long long)totalPoints.load(), wall / 1e9, paths.size() / (wall / 1e9), totalPoints / (wall / 1e3));
+	printf("%-10s %8s %10s %9s %9s %9s\n", "Stage", "Threads", "Files", "Busy", "Starved", "Blocked");
+	printBatchStage(readStage, wall);
+	printBatchStage(computeStage, wall);
+	printBatchStage(writeStage, wall);
+
+	//the busiest stage per thread is the one holding the others up
+	const BatchStageStats* stages[3] = { &readStage, &computeStage, &writeStage };
+	const BatchStageStats* bottleneck = *std::max_element(stages, stages + 3, [](const BatchStageStats* left, const BatchStageStats* right) {
+		return (double)left->busy / left->threads < (double)right->busy / right->threads;
+		});
+	printf("Bottleneck: %s\n", bottleneck->name);
+	return failedFiles > 0 ? 1 : 0;
+}
@@ -0,0 +1,461 @@
+#pragma once
+
+/*
+Micro-benchmarks for the engine's hot loops.
+They're turned on with RUN_BENCHMARKS in quickhull.cpp, in which case the program runs them, prints the results and exits.
+
+Times are given in CPU cycles per input point (read from the timestamp counter where there is one, nanoseconds otherwise),
+so that results for different input sizes can be compared directly.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "point.h"
+#include "segmentclassifier.h"
+#include "blockedpartition.h"
+#include "compressedpoints.h"
+#include "hullengine.h"
+#include "pointgenerator.h"
+#include "distributions.h"
+#include "grouphull.h"
+#include "tilehull.h"
+#include "anytimehull.h"
+
+//input sizes every benchmark is run at
+const size_t benchmarkSizes[] = { 100000, 1000000, 10000000 };
+
+//how many keys the grouped hull benchmark spreads its points over
+const uint32_t benchmarkGroups = 1000;
+
+//size of the allocation benchmark. 100 million points is 800 MB per buffer.
+const size_t allocationBenchmarkSize = 100000000;
+
+//how many small random inputs the anytime hull's error bound is checked on, and the most points in each
+const int anytimeBoundChecks = 20000;
+const int anytimeBoundMaxPoints = 32;
+
+//every measurement is the best of this many runs
+const int benchmarkRuns = 3;
+
+inline unsigned long long benchmarkCycles() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//runs a job a few times and returns its best time in cycles per point
+template<class Job>
+double benchmarkCyclesPerPoint(size_t pointCount, Job job) {
+	unsigned long long best = 0;
+	for (int run = 0; run < benchmarkRuns; run++) {
+		unsigned long long start = benchmarkCycles();
+		job();
+		unsigned long long cycles = benchmarkCycles() - start;
+		if (run == 0 || cycles < best) {
+			best = cycles;
+		}
+	}
+	return (double)best / pointCount;
+}
+
+//the window randomizeInput fills
+const GeneratorBounds benchmarkBounds = { 10, 10, 1270, 710 };
+
+//the whole coordinate range the engine takes, so that distributions like PD_Circle aren't squashed by rounding to the window
+const GeneratorBounds benchmarkWideBounds = { -(1 << 30), -(1 << 30), 1 << 30, 1 << 30 };
+
+//the same window-sized points randomizeInput makes, from a fixed seed so that every run measures the same input
+inline PointList benchmarkPoints(size_t count, unsigned int seed, PointDistribution distribution = PD_Uniform, const GeneratorBounds& bounds = benchmarkBounds) {
+	ThreadPoolExecutor exec;
+	return distributionPoints(exec, PointGenerator(seed), distribution, count, bounds);
+}
+
+//the plain loops, written the same way as QuickHull::calcPointsOnRightSide and calculateFurthestPoint: one pass per side, then one more per side for its furthest point
+inline void benchmarkPlainSplit(Point P, Point Q, Point C, const PointList& list, PointList& setOne, PointList& setTwo, Point& furthestOne, Point& furthestTwo) {
+	auto rightSide = [&](Point begin, Point end, PointList& out) {
+		SegmentClassifier line(begin, end);
+		out.clear();
+		for (size_t x = 0; x < list.size(); x++) {
+			if (line.isRight(list[x])) {
+				out.push_back(list[x]);
+			}
+		}
+	};
+	auto furthest = [](Point begin, Point end, const PointList& set) {
+		SegmentClassifier line(begin, end);
+		Point best = set.empty() ? Point{ 0, 0 } : set[0];
+		long long prevMax = -1;
+		for (size_t x = 0; x < set.size(); x++) {
+			long long distance = -line.side(set[x]);
+			if (distance > prevMax) {
+				prevMax = distance;
+				best = set[x];
+			}
+		}
+		return best;
+	};
+
+	rightSide(P, C, setOne);
+	rightSide(C, Q, setTwo);
+	furthestOne = furthest(P, C, setOne);
+	furthestTwo = furthest(C, Q, setTwo);
+}
+
+//compares the plain split against the cache-blocked one on the first split of a random input (leftmost to rightmost point)
+inline void runPartitionBenchmark() {
+	printf("Partition + furthest point, cycles per point\n");
+	printf("%12s %12s %12s %10s\n", "points", "plain", "blocked", "speedup");
+
+	for (size_t count : benchmarkSizes) {
+		PointList points = benchmarkPoints(count, 1);
+		Point minPoint = points[0], maxPoint = points[0];
+		for (const Point& p : points) {
+			if (pointLessThan(p, minPoint)) {
+				minPoint = p;
+			}
+			if (pointLessThan(maxPoint, p)) {
+				maxPoint = p;
+			}
+		}
+
+		PointList plainOne, plainTwo;
+		Point plainFurthestOne, plainFurthestTwo;
+		double plain = benchmarkCyclesPerPoint(count, [&]() {
+			benchmarkPlainSplit(minPoint, minPoint, maxPoint, points, plainOne, plainTwo, plainFurthestOne, plainFurthestTwo);
+			});
+
+		PointList blockedOne(count), blockedTwo(count);
+		size_t countOne = 0, countTwo = 0;
+		FurthestTracker furthestOne, furthestTwo;
+		double blocked = benchmarkCyclesPerPoint(count, [&]() {
+			furthestOne = FurthestTracker();
+			furthestTwo = FurthestTracker();
+			partitionBlocked(minPoint, minPoint, maxPoint, points.data(), count, blockedOne.data(), blockedTwo.data(), countOne, countTwo, furthestOne, furthestTwo);
+			});
+
+		//both have to agree, or the numbers don't mean anything
+		bool agree = countOne == plainOne.size() && countTwo == plainTwo.size()
+			&& (countOne == 0 || comparePoints(blockedOne[furthestOne.index], plainFurthestOne))
+			&& (countTwo == 0 || comparePoints(blockedTwo[furthestTwo.index], plainFurthestTwo));
+
+		printf("%12zu %12.2f %12.2f %9.2fx%s\n", count, plain, blocked, plain / blocked, agree ? "" : "  (results differ!)");
+	}
+}
+
+//allocates, fills, scans and randomly reads one big buffer of points. List is either a plain std::vector or a PointList.
+template<class List>
+void benchmarkBuffer(const char* name, size_t count) {
+	unsigned long long start = benchmarkCycles();
+	List points(count);
+	unsigned int state = 1;
+	for (size_t x = 0; x < count; x++) {
+		state = state * 1664525u + 1013904223u;
+		points[x].x = (state >> 8) % 1260 + 10;
+		points[x].y = (state >> 16) % 700 + 10;
+	}
+	double fill = (double)(benchmarkCycles() - start) / count;
+
+	long long sum = 0;
+	double scan = benchmarkCyclesPerPoint(count, [&]() {
+		for (size_t x = 0; x < count; x++) {
+			sum += points[x].x ^ points[x].y;
+		}
+		});
+
+	//random reads are where the TLB hurts most, since nearly every read lands on a different page
+	size_t reads = count / 10;
+	double gather = benchmarkCyclesPerPoint(reads, [&]() {
+		unsigned long long index = 12345;
+		for (size_t x = 0; x < reads; x++) {
+			index = index * 6364136223846793005ull + 1442695040888963407ull;
+			sum += points[(index >> 20) % count].x;
+		}
+		});
+
+	printf("%22s %12.2f %12.2f %12.2f   (checksum %lld)\n", name, fill, scan, gather, sum & 0xFF);
+}
+
+//compares default vector allocation against BigBufferAllocator on one very large input
+inline void runAllocationBenchmark() {
+	printf("Big buffer allocation, %zu points, cycles per point\n", allocationBenchmarkSize);
+	printf("%22s %12s %12s %12s\n", "allocator", "alloc+fill", "scan", "random read");
+	benchmarkBuffer<std::vector<Point>>("std::allocator", allocationBenchmarkSize);
+	benchmarkBuffer<PointList>("BigBufferAllocator", allocationBenchmarkSize);
+
+	BigBufferStats& stats = bigBufferStats();
+	printf("big buffers so far: %zu on explicit huge pages, %zu on transparent huge pages, %zu on normal pages\n",
+		stats.explicitHugePages.load(), stats.transparentHugePages.load(), stats.normalPages.load());
+}
+
+//size and decoding speed of compressed points, and the hull computed from them compared to the plain list
+inline void runCompressionBenchmark() {
+	printf("Compressed points (sorted input, one thread), cycles per point\n");
+	printf("%12s %12s %12s %12s %12s\n", "points", "bytes/point", "decode", "hull plain", "hull packed");
+
+	SequentialExecutor exec;
+	for (size_t count : benchmarkSizes) {
+		PointList points = benchmarkPoints(count, 1);
+		std::sort(points.begin(), points.end(), pointLessThan);
+		CompressedPointList compressed(points);
+
+		PointList decoded;
+		double decode = benchmarkCyclesPerPoint(count, [&]() {
+			decoded = compressed.decompress(exec);
+			});
+
+		std::vector<Point> plainHull, packedHull;
+		double plain = benchmarkCyclesPerPoint(count, [&]() {
+			plainHull = computeHullPoints(exec, points);
+			});
+		double packed = benchmarkCyclesPerPoint(count, [&]() {
+			packedHull = computeHullPoints(exec, compressed);
+			});
+
+		bool agree = decoded.size() == points.size() && std::equal(decoded.begin(), decoded.end(), points.begin(), comparePoints)
+			&& plainHull.size() == packedHull.size() && std::equal(plainHull.begin(), plainHull.end(), packedHull.begin(), comparePoints);
+
+		printf("%12zu %12.2f %12.2f %12.2f %12.2f%s\n", count, (double)compressed.compressedBytes() / count, decode, plain, packed, agree ? "" : "  (results differ!)");
+	}
+}
+
+//making random inputs: the old rand() loop against the counter-based generator on one thread and on every core, and sorted output against sorting afterwards
+inline void runGenerationBenchmark() {
+	SequentialExecutor sequential;
+	ThreadPoolExecutor pool;
+	printf("Input generation (%d threads), cycles per point\n", pool.concurrency());
+	printf("%12s %12s %12s %12s %12s %12s\n", "points", "rand()", "1 thread", "threads", "then sort", "sorted");
+
+	for (size_t count : benchmarkSizes) {
+		PointGenerator generator(1);
+		PointList randPoints(count), single, parallel, sortedAfter, sorted;
+
+		double randLoop = benchmarkCyclesPerPoint(count, [&]() {
+			srand(1);
+			for (size_t x = 0; x < count; x++) {
+				randPoints[x].x = rand() % 1260 + 10;
+				randPoints[x].y = rand() % 700 + 10;
+			}
+			});
+		double one = benchmarkCyclesPerPoint(count, [&]() {
+			single = generator.uniformPoints(sequential, count, benchmarkBounds);
+			});
+		double many = benchmarkCyclesPerPoint(count, [&]() {
+			parallel = generator.uniformPoints(pool, count, benchmarkBounds);
+			});
+		double sortAfter = benchmarkCyclesPerPoint(count, [&]() {
+			sortedAfter = generator.uniformPoints(pool, count, benchmarkBounds);
+			std::sort(sortedAfter.begin(), sortedAfter.end(), pointLessThan);
+			});
+		double sortedDirect = benchmarkCyclesPerPoint(count, [&]() {
+			sorted = generator.sortedUniformPoints(pool, count, benchmarkBounds);
+			});
+
+		//the thread count mustn't change the points, and sorting them as they're made mustn't either
+		bool agree = std::equal(single.begin(), single.end(), parallel.begin(), parallel.end(), comparePoints)
+			&& std::equal(sortedAfter.begin(), sortedAfter.end(), sorted.begin(), sorted.end(), comparePoints);
+
+		printf("%12zu %12.2f %12.2f %12.2f %12.2f %12.2f%s\n", count, randLoop, one, many, sortAfter, sortedDirect, agree ? "" : "  (results differ!)");
+	}
+}
+
+//the whole hull (sort and recursion) on every distribution, so that a change that only helps the uniform case shows up as such.
+//the tiled hull (see tilehull.h) starts from the unsorted points, so it's up against sort + threads.
+inline void runDistributionBenchmark() {
+	SequentialExecutor sequential;
+	ThreadPoolExecutor pool;
+	printf("Hull by input distribution (full coordinate range), cycles per point\n");
+	printf("%16s %12s %12s %12s %12s %12s %12s %12s\n", "distribution", "points", "hull points", "sort", "1 thread", "threads", "tiled", "tiles kept");
+
+	for (int distribution = 0; distribution < PD_Count; distribution++) {
+		for (size_t count : benchmarkSizes) {
+			PointList points = benchmarkPoints(count, 1, (PointDistribution)distribution, benchmarkWideBounds);
+			PointList sorted;
+			double sort = benchmarkCyclesPerPoint(count, [&]() {
+				sorted = points;
+				std::sort(sorted.begin(), sorted.end(), pointLessThan);
+				});
+
+			std::vector<Point> singleHull, parallelHull;
+			double single = benchmarkCyclesPerPoint(count, [&]() {
+				singleHull = computeHullPoints(sequential, sorted);
+				});
+			double parallel = benchmarkCyclesPerPoint(count, [&]() {
+				parallelHull = computeHullPoints(pool, sorted);
+				});
+
+			std::vector<Point> tiledHull;
+			TiledHullStats tileStats;
+			double tiled = benchmarkCyclesPerPoint(count, [&]() {
+				tiledHull = computeTiledHull(pool, points, &tileStats);
+				});
+
+			bool agree = singleHull.size() == parallelHull.size() && singleHull.size() == tiledHull.size();
+			printf("%16s %12zu %12zu %12.2f %12.2f %12.2f %12.2f %7zu/%zu%s\n", distributionName((PointDistribution)distribution), count, singleHull.size(),
+				sort, single, parallel, tiled, tileStats.keptTiles, tileStats.tiles, agree ? "" : "  (results differ!)");
+		}
+	}
+}
+
+//hulls of labeled points, one per key: going through the groups one at a time against the grouped radix partition (see grouphull.h)
+inline void runGroupedHullBenchmark() {
+	SequentialExecutor sequential;
+	ThreadPoolExecutor pool;
+	printf("Grouped hulls (%u keys), cycles per point\n", benchmarkGroups);
+	printf("%12s %12s %12s %12s\n", "points", "one by one", "grouped", "speedup");
+
+	for (size_t count : benchmarkSizes) {
+		PointList points = benchmarkPoints(count, 1, PD_Uniform, benchmarkWideBounds);
+		PointGenerator keyGenerator(2);
+		std::vector<KeyedPoint> records(count);
+		for (size_t x = 0; x < count; x++) {
+			records[x].key = philoxBounded(philoxWord64(keyGenerator.block(x), 0), benchmarkGroups);
+			records[x].point = points[x];
+		}
+
+		//the way it'd be done without a grouped API: sort by key, then copy, sort and hull each group on its own
+		std::vector<Point> oneByOneHulls;
+		double oneByOne = benchmarkCyclesPerPoint(count, [&]() {
+			std::vector<KeyedPoint> sorted = records;
+			std::stable_sort(sorted.begin(), sorted.end(), [](const KeyedPoint& left, const KeyedPoint& right) { return left.key < right.key; });
+			oneByOneHulls.clear();
+			for (size_t begin = 0, end = 0; begin < sorted.size(); begin = end) {
+				PointList group;
+				for (end = begin; end < sorted.size() && sorted[end].key == sorted[begin].key; end++) {
+					group.push_back(sorted[end].point);
+				}
+				std::sort(group.begin(), group.end(), pointLessThan);
+				std::vector<Point> hull = orderHull(computeHullPoints(sequential, group));
+				oneByOneHulls.insert(oneByOneHulls.end(), hull.begin(), hull.end());
+			}
+			});
+
+		GroupedHulls grouped;
+		double groupedTime = benchmarkCyclesPerPoint(count, [&]() {
+			std::vector<KeyedPoint> unsorted = records;
+			grouped = computeGroupedHulls(pool, unsorted);
+			});
+
+		bool agree = std::equal(oneByOneHulls.begin(), oneByOneHulls.end(), grouped.hullPoints.begin(), grouped.hullPoints.end(), comparePoints);
+		printf("%12zu %12.2f %12.2f %11.2fx%s\n", count, oneByOne, groupedTime, oneByOne / groupedTime, agree ? "" : "  (results differ!)");
+	}
+}
+
+//distance from p to a convex polygon given in order around it (0 inside or on it), worked out the slow way: against every edge
+inline double benchmarkPolygonDistance(const std::vector<Point>& polygon, Point p) {
+	bool left = false, right = false;
+	double nearest = -1;
+	for (size_t x = 0; x < polygon.size(); x++) {
+		Point a = polygon[x], b = polygon[(x + 1) % polygon.size()];
+		long long side = SegmentClassifier(a, b).side(p);
+		left |= side > 0;
+		right |= side < 0;
+		double distance = segmentDistanceSquared(a, b, p);
+		if (nearest < 0 || distance < nearest) {
+			nearest = distance;
+		}
+	}
+	//a polygon with fewer than three corners has no inside
+	if (polygon.size() > 2 && !(left && right)) {
+		return 0;
+	}
+	return std::sqrt(nearest);
+}
+
+//best-first refinement (see anytimehull.h): first a check that currentError() really bounds every point's distance from the hull at every step, on lots of small inputs,
+//then how the error falls over time on big ones
+inline void runAnytimeHullBenchmark() {
+	SequentialExecutor sequential;
+	ThreadPoolExecutor pool;
+
+	//small boxes make plenty of collinear and repeated points, wide ones plenty of long thin triangles
+	const GeneratorBounds checkBounds[] = { { 0, 0, 16, 16 }, benchmarkBounds, benchmarkWideBounds };
+	size_t checks = 0, exceeded = 0, increased = 0, incomplete = 0;
+	double worstRatio = 0;
+	for (int input = 0; input < anytimeBoundChecks; input++) {
+		PointGenerator generator(3, (uint32_t)input);
+		size_t count = 3 + philoxBounded(philoxWord64(generator.block(0, 1), 0), anytimeBoundMaxPoints - 2);
+		PointDistribution distribution = (PointDistribution)(input % PD_Count);
+		PointList points = distributionPoints(sequential, generator, distribution, count, checkBounds[input % 3]);
+		std::sort(points.begin(), points.end(), pointLessThan);
+
+		AnytimeHull anytime;
+		anytime.start(sequential, points);
+		double lastError = anytime.currentError();
+		while (true) {
+			std::vector<Point> hull = orderHull(anytime.getHullPoints());
+			double furthest = 0;
+			for (const Point& p : points) {
+				furthest = std::max(furthest, benchmarkPolygonDistance(hull, p));
+			}
+			checks++;
+			if (furthest > anytime.currentError() * (1 + 1e-9) + 1e-9) {
+				exceeded++;
+				worstRatio = std::max(worstRatio, anytime.currentError() > 0 ? furthest / anytime.currentError() : INFINITY);
+			}
+			if (!anytime.refine(sequential)) {
+				break;
+			}
+			increased += anytime.currentError() > lastError;
+			lastError = anytime.currentError();
+		}
+		std::vector<Point> expected = computeHullPoints(sequential, points);
+		incomplete += anytime.currentError() != 0 || anytime.getHullPoints().size() != expected.size();
+	}
+	printf("Anytime hull error bound: %zu steps of %d inputs checked against the distance to the hull, exceeded %zu times", checks, anytimeBoundChecks, exceeded);
+	if (exceeded > 0) {
+		printf(" (by up to %.2fx)", worstRatio);
+	}
+	printf(", rose %zu times, %zu hulls wrong at the end%s\n\n", increased, incomplete, exceeded + increased + incomplete > 0 ? "  (results differ!)" : "");
+
+	printf("Anytime hull error over time (%d threads), as a share of the input's width\n", pool.concurrency());
+	printf("%16s %12s %12s %12s %12s %12s\n", "distribution", "points", "steps", "ms", "hull points", "error");
+	const double width = (double)benchmarkWideBounds.maxX - benchmarkWideBounds.minX;
+	for (PointDistribution distribution : { PD_Uniform, PD_Disk, PD_Circle }) {
+		size_t count = benchmarkSizes[1];
+		PointList points = benchmarkPoints(count, 1, distribution, benchmarkWideBounds);
+		std::sort(points.begin(), points.end(), pointLessThan);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		AnytimeHull anytime;
+		anytime.start(pool, points);
+		size_t steps = 0;
+		for (size_t report = 1; ; report *= 4) {
+			while (steps < report && anytime.refine(pool)) {
+				steps++;
+			}
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			printf("%16s %12zu %12zu %12.2f %12zu %12.2e\n", distributionName(distribution), count, steps, ms, anytime.getHullPoints().size(), anytime.currentError() / width);
+			if (anytime.done()) {
+				break;
+			}
+		}
+	}
+}
+
+inline void runBenchmarks() {
+	runAnytimeHullBenchmark();
+	printf("\n");
+	runGenerationBenchmark();
+	printf("\n");
+	runDistributionBenchmark();
+	printf("\n");
+	runGroupedHullBenchmark();
+	printf("\n");
+	runPartitionBenchmark();
+	printf("\n");
+	runCompressionBenchmark();
+	printf("\n");
+	runAllocationBenchmark();
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+/*
+Allocator for the engine's big point buffers.
+
+Every buffer is aligned to a cache line (64 bytes), so vector loads and the streaming stores in blockedpartition.h never straddle two lines.
+Buffers of a couple of megabytes or more are also backed by huge pages when the system allows it, which cuts down on TLB misses when going through hundreds of megabytes of points.
+In order of preference:
+	Linux: explicit huge pages (MAP_HUGETLB, only if the admin has reserved some), then transparent huge pages (madvise), then normal pages.
+	Windows: large pages (needs the "Lock pages in memory" privilege), then normal VirtualAlloc pages.
+	Anywhere else: aligned operator new.
+Whichever way the memory comes, nothing else about the buffer changes, so a failed huge page request just quietly falls back to the next option.
+
+Like the allocator it replaced, it also leaves new elements uninitialized when a vector is resized.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "memprofile.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+//alignment of every buffer
+const size_t bigBufferAlignment = 64;
+
+//buffers at least this big are worth putting on huge pages (one 2 MB huge page)
+const size_t hugePageSize = 2 * 1024 * 1024;
+
+//how many big buffers ended up on each kind of memory. printed by the allocation benchmark.
+struct BigBufferStats {
+	std::atomic<size_t> explicitHugePages{ 0 };
+	std::atomic<size_t> transparentHugePages{ 0 };
+	std::atomic<size_t> normalPages{ 0 };
+};
+
+inline BigBufferStats& bigBufferStats() {
+	static BigBufferStats stats;
+	return stats;
+}
+
+inline size_t roundUpToHugePage(size_t bytes) {
+	return (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+}
+
+//gets memory for a buffer of at least hugePageSize bytes. freed with releaseHugeBuffer using the same size.
+inline void* allocateHugeBuffer(size_t bytes) {
+	size_t mappedBytes = roundUpToHugePage(bytes);
+
+#if defined(_WIN32)
+	SIZE_T largePage = GetLargePageMinimum();
+	if (largePage != 0 && mappedBytes % largePage == 0) {
+		void* memory = VirtualAlloc(nullptr, mappedBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (memory != nullptr) {
+			bigBufferStats().explicitHugePages++;
+			return memory;
+		}
+	}
+	void* memory = VirtualAlloc(nullptr, mappedBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	bigBufferStats().normalPages++;
+	return memory;
+#elif defined(__linux__)
+#ifdef MAP_HUGETLB
+	void* memory = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (memory != MAP_FAILED) {
+		bigBufferStats().explicitHugePages++;
+		return memory;
+	}
+#endif
+
+	//transparent huge pages only cover 2 MB aligned ranges, so map a bit extra and trim it down to an aligned range
+	char* mapping = (char*)mmap(nullptr, mappedBytes + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+	char* aligned = (char*)(((uintptr_t)mapping + hugePageSize - 1) & ~(uintptr_t)(hugePageSize - 1));
+	if (aligned > mapping) {
+		munmap(mapping, aligned - mapping);
+	}
+	size_t tail = (mapping + mappedBytes + hugePageSize) - (aligned + mappedBytes);
+	if (tail > 0) {
+		munmap(aligned + mappedBytes, tail);
+	}
+
+#ifdef MADV_HUGEPAGE
+	if (madvise(aligned, mappedBytes, MADV_HUGEPAGE) == 0) {
+		bigBufferStats().transparentHugePages++;
+		return aligned;
+	}
+#endif
+	bigBufferStats().normalPages++;
+	return aligned;
+#else
+	bigBufferStats().normalPages++;
+	return ::operator new(mappedBytes, std::align_val_t(bigBufferAlignment));
+#endif
+}
+
+inline void releaseHugeBuffer(void* memory, size_t bytes) {
+#if defined(_WIN32)
+	VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+	munmap(memory, roundUpToHugePage(bytes));
+#else
+	::operator delete(memory, std::align_val_t(bigBufferAlignment));
+#endif
+}
+
+template<class T>
+struct BigBufferAllocator {
+	typedef T value_type;
+
+	template<class U>
+	struct rebind {
+		typedef BigBufferAllocator<U> other;
+	};
+
+	BigBufferAllocator() = default;
+
+	template<class U>
+	BigBufferAllocator(const BigBufferAllocator<U>&) noexcept {}
+
+	T* allocate(size_t count) {
+		size_t bytes = count * sizeof(T);
+		if (bytes >= hugePageSize) {
+			//these never go through operator new, so the memory profiler has to be told about them directly
+			MEMORY_COUNT_MAPPED(bytes);
+			return (T*)allocateHugeBuffer(bytes);
+		}
+		return (T*)::operator new(bytes, std::align_val_t(bigBufferAlignment));
+	}
+
+	//the size decides which kind of memory a buffer got, so it's enough to know how to give it back
+	void deallocate(T* memory, size_t count) noexcept {
+		size_t bytes = count * sizeof(T);
+		if (bytes >= hugePageSize) {
+			MEMORY_UNCOUNT_MAPPED(bytes);
+			releaseHugeBuffer(memory, bytes);
+			return;
+		}
+		::operator delete(memory, std::align_val_t(bigBufferAlignment));
+	}
+
+	//resizing leaves new elements uninitialized. big point lists are sized up front and then filled in, and zeroing them first would be a whole extra pass over memory.
+	template<class U>
+	void construct(U* location) noexcept {
+		::new ((void*)location) U;
+	}
+
+	template<class U, class... Args>
+	void construct(U* location, Args&&... args) {
+		::new ((void*)location) U(std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	bool operator==(const BigBufferAllocator<U>&) const noexcept { return true; }
+
+	template<class U>
+	bool operator!=(const BigBufferAllocator<U>&) const noexcept { return false; }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+Cache-blocked partitioning for large subproblems.
+
+Once a subproblem is much bigger than the caches, splitting it is limited by memory bandwidth, not by the arithmetic.
+The plain loops make it worse by going over the points more than once per level: once for each side of the split, and again later to find each side's furthest point.
+
+This kernel reads the input once.
+It walks the points in L2-sized tiles, prefetching a little way ahead.
+Each point is classified against both new lines, and the furthest point of each side is tracked on the way, since that's the same determinant.
+Both outputs are gathered a cache line at a time and written with non-temporal stores, so they don't evict the input that's still being read.
+*/
+
+#include <cstdint>
+#include <cstring>
+
+#include "point.h"
+#include "segmentclassifier.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLOCKED_PARTITION_X86 1
+#else
+#define BLOCKED_PARTITION_X86 0
+#endif
+
+//points per tile. 32768 points is 256 KB, which leaves room in a typical L2 for the outputs being gathered.
+const size_t partitionTilePoints = 32768;
+
+//how far ahead of the current point to prefetch, in points (2 KB, or 32 cache lines)
+const size_t partitionPrefetchDistance = 256;
+
+//subproblems smaller than this already sit in cache, so the plain loops are just as fast
+const size_t blockedPartitionThreshold = 1 << 20;
+
+//furthest point found so far on one side of a split
+struct FurthestTracker {
+	long long distance = -1;
+	size_t index = 0;
+};
+
+//gathers points into a cache line and writes full lines out with streaming stores
+class StreamingPointWriter {
+private:
+	static const int linePoints = 64 / sizeof(Point);
+
+	Point* out;
+	size_t written = 0;
+	alignas(64) Point line[linePoints];
+	int lineCount = 0;
+
+	void flushLine() {
+		Point* destination = out + written;
+#if BLOCKED_PARTITION_X86 == 1
+		if (lineCount == linePoints && ((uintptr_t)destination & 15) == 0) {
+			const __m128i* source = (const __m128i*)line;
+			for (int x = 0; x < linePoints * (int)sizeof(Point) / 16; x++) {
+				_mm_stream_si128((__m128i*)destination + x, _mm_load_si128(source + x));
+			}
+			written += lineCount;
+			lineCount = 0;
+			return;
+		}
+#endif
+		memcpy(destination, line, lineCount * sizeof(Point));
+		written += lineCount;
+		lineCount = 0;
+	}
+
+public:
+	StreamingPointWriter(Point* output) : out(output) {}
+
+	//always writes the point into the line, but only keeps it if keep is set. saves a hard-to-predict branch per point.
+	void push(Point p, bool keep) {
+		line[lineCount] = p;
+		lineCount += keep;
+		if (lineCount == linePoints) {
+			flushLine();
+		}
+	}
+
+	//position the next kept point will end up at
+	size_t position() const {
+		return written + lineCount;
+	}
+
+	//writes out whatever is left and returns the total amount of points written
+	size_t finish() {
+		if (lineCount > 0) {
+			flushLine();
+		}
+#if BLOCKED_PARTITION_X86 == 1
+		//streaming stores aren't ordered with normal ones, so make sure they've landed before anyone reads the output
+		_mm_sfence();
+#endif
+		return written;
+	}
+};
+
+//splits list[0, count) into the points right of P->C and the ones right of C->Q, in their original order.
+//outOne and outTwo need room for count points each. also finds each side's furthest point from its own line (index into its output).
+//returns the sizes of both outputs through countOne and countTwo.
+inline void partitionBlocked(Point P, Point Q, Point C, const Point* list, size_t count, Point* outOne, Point* outTwo,
+	size_t& countOne, size_t& countTwo, FurthestTracker& furthestOne, FurthestTracker& furthestTwo) {
+	StreamingPointWriter writerOne(outOne), writerTwo(outTwo);
+	SegmentClassifier lineOne(P, C), lineTwo(C, Q);
+
+	for (size_t tileStart = 0; tileStart < count; tileStart += partitionTilePoints) {
+		size_t tileEnd = std::min(count, tileStart + partitionTilePoints);
+
+		for (size_t x = tileStart; x < tileEnd; x++) {
+#if BLOCKED_PARTITION_X86 == 1
+			//one prefetch per cache line is enough
+			if ((x & 7) == 0 && x + partitionPrefetchDistance < count) {
+				_mm_prefetch((const char*)(list + x + partitionPrefetchDistance), _MM_HINT_T0);
+			}
+#endif
+			Point p = list[x];
+			long long determinantOne = lineOne.side(p);
+			long long determinantTwo = lineTwo.side(p);
+			bool isOne = determinantOne < 0;
+			bool isTwo = !isOne && determinantTwo < 0;
+
+			if (isOne && -determinantOne > furthestOne.distance) {
+				furthestOne.distance = -determinantOne;
+				furthestOne.index = writerOne.position();
+			}
+			if (isTwo && -determinantTwo > furthestTwo.distance) {
+				furthestTwo.distance = -determinantTwo;
+				furthestTwo.index = writerTwo.position();
+			}
+
+			writerOne.push(p, isOne);
+			writerTwo.push(p, isTwo);
+		}
+	}
+
+	countOne = writerOne.finish();
+	countTwo = writerTwo.finish();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+A blocking queue with a fixed capacity, for handing work from one thread to another.
+
+push() waits while the queue is full, which keeps a fast producer (reading input, say) from running arbitrarily far ahead of a slow consumer and filling up memory.
+pop() waits while it's empty. Once close() is called, pushes are refused and pops drain whatever is left, then return false.
+*/
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+template<class T>
+class BoundedQueue {
+private:
+	std::mutex queueLock;
+	std::condition_variable notFull, notEmpty;
+	std::deque<T> items;
+	size_t capacity;
+	bool closed = false;
+
+public:
+	BoundedQueue(size_t maxItems) : capacity(maxItems) {}
+
+	//waits for room, then adds the item. returns false (dropping the item) if the queue was closed.
+	bool push(T item) {
+		std::unique_lock<std::mutex> lock(queueLock);
+		notFull.wait(lock, [&]() { return closed || items.size() < capacity; });
+		if (closed) {
+			return false;
+		}
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	//waits for an item. returns false once the queue is closed and empty.
+	bool pop(T& item) {
+		std::unique_lock<std::mutex> lock(queueLock);
+		notEmpty.wait(lock, [&]() { return closed || !items.empty(); });
+		if (items.empty()) {
+			return false;
+		}
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	//no more items will be pushed. wakes up everything waiting on the queue.
+	void close() {
+		std::lock_guard<std::mutex> lock(queueLock);
+		closed = true;
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+};
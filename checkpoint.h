@@ -0,0 +1,153 @@
+#pragma once
+
+/*
+Checkpoints for long stepped runs, so that a run that gets killed can be picked up again later instead of starting over.
+
+All a stepped run still has to do is a list of subproblems: a segment, and the sorted points to its right that haven't been ruled out yet.
+Everything else it ever looked at is either already in the hull or known to be inside it, so a checkpoint is just the hull points found so far plus that list, in the order they'd be worked on.
+Each subproblem's points are stored compressed (see compressedpoints.h), since they're sorted anyway, which keeps even the first checkpoints of a huge run small.
+
+Checkpoints are written under a temporary name and then renamed over the old one, so a run killed half-way through writing one still leaves the previous checkpoint intact.
+SIGINT and SIGTERM only set a flag (see checkpointStopRequested()), so whoever is stepping can save a last checkpoint and stop cleanly.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+
+#include "point.h"
+#include "executor.h"
+#include "compressedpoints.h"
+
+const char checkpointFileMagic[8] = { 'Q', 'H', 'C', 'H', 'E', 'C', 'K', 'P' };
+const uint32_t checkpointFileVersion = 1;
+
+struct CheckpointFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t hullCount;
+	uint64_t stepCount;
+};
+
+//one subproblem still to be worked on: the points right of segmentA->segmentB, sorted with pointLessThan
+struct CheckpointStep {
+	Point segmentA, segmentB;
+	PointList pointSet;
+};
+
+struct HullCheckpoint {
+	//hull points found so far, in the order they were found
+	std::vector<Point> hullPoints;
+
+	//subproblems in the order they'd be worked on. none of them are empty.
+	std::vector<CheckpointStep> steps;
+
+	size_t pendingPoints() const {
+		size_t total = 0;
+		for (const CheckpointStep& step : steps) {
+			total += step.pointSet.size();
+		}
+		return total;
+	}
+};
+
+//returns false, leaving any older checkpoint alone, if it couldn't be written
+inline bool saveCheckpoint(const std::string& path, const HullCheckpoint& checkpoint) {
+	std::filesystem::path temporary = path;
+	temporary += ".tmp";
+	{
+		std::ofstream outfile(temporary, std::ios::binary | std::ios::trunc);
+		if (!outfile.is_open()) {
+			return false;
+		}
+		CheckpointFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, checkpointFileMagic, sizeof(header.magic));
+		header.version = checkpointFileVersion;
+		header.hullCount = checkpoint.hullPoints.size();
+		header.stepCount = checkpoint.steps.size();
+		outfile.write((const char*)&header, sizeof(header));
+		outfile.write((const char*)checkpoint.hullPoints.data(), checkpoint.hullPoints.size() * sizeof(Point));
+
+		for (const CheckpointStep& step : checkpoint.steps) {
+			outfile.write((const char*)&step.segmentA, sizeof(Point));
+			outfile.write((const char*)&step.segmentB, sizeof(Point));
+			CompressedPointList(step.pointSet).save(outfile);
+		}
+		outfile.flush();
+		if (!outfile.good()) {
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error) {
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+//returns false if there's no checkpoint at path, or it isn't a valid one
+inline bool loadCheckpoint(const std::string& path, HullCheckpoint& checkpoint) {
+	checkpoint = HullCheckpoint();
+	std::error_code error;
+	uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error) {
+		return false;
+	}
+	std::ifstream infile(path, std::ios::binary);
+	CheckpointFileHeader header;
+	if (!infile.is_open() || !infile.read((char*)&header, sizeof(header)) || memcmp(header.magic, checkpointFileMagic, sizeof(header.magic)) != 0
+		|| header.version != checkpointFileVersion || header.hullCount > fileSize / sizeof(Point) || header.stepCount > fileSize / (sizeof(Point) * 2)) {
+		return false;
+	}
+
+	checkpoint.hullPoints.resize(header.hullCount);
+	if (!infile.read((char*)checkpoint.hullPoints.data(), checkpoint.hullPoints.size() * sizeof(Point))) {
+		return false;
+	}
+
+	SequentialExecutor exec;
+	for (uint64_t x = 0; x < header.stepCount; x++) {
+		CheckpointStep step;
+		CompressedPointList points;
+		if (!infile.read((char*)&step.segmentA, sizeof(Point)) || !infile.read((char*)&step.segmentB, sizeof(Point)) || !points.load(infile)) {
+			checkpoint = HullCheckpoint();
+			return false;
+		}
+		if (points.empty()) {
+			continue;
+		}
+		step.pointSet = points.decompress(exec);
+		checkpoint.steps.push_back(std::move(step));
+	}
+	return true;
+}
+
+inline std::atomic<bool>& checkpointStopFlag() {
+	static std::atomic<bool> stop{ false };
+	return stop;
+}
+
+extern "C" inline void checkpointSignalHandler(int) {
+	checkpointStopFlag() = true;
+}
+
+//makes SIGINT and SIGTERM ask the run to save and stop, instead of killing it on the spot
+inline void installCheckpointSignalHandlers() {
+	signal(SIGINT, checkpointSignalHandler);
+	signal(SIGTERM, checkpointSignalHandler);
+}
+
+inline bool checkpointStopRequested() {
+	return checkpointStopFlag();
+}
@@ -0,0 +1,369 @@
+#pragma once
+
+/*
+Compressed storage for sorted point lists.
+
+Once the points are sorted with pointLessThan, neighbouring x values are almost always the same or only a little apart, so storing the differences takes far less room than the points themselves.
+Points are stored in blocks of a few thousand. Each block keeps its first point as is, and every point after it as two varints (7 bits per byte, high bit set if more bytes follow):
+	the x difference from the previous point, which is never negative, all stored first,
+	then the y difference, zigzag encoded so that small negative numbers stay small too.
+Keeping the x differences together means they're nearly all one byte each, which lets the decoder handle 16 of them at a time with SSE2.
+For the random inputs the visualizer makes, that's about 2 bytes per point instead of 8.
+
+Blocks decode independently, so they can be spread over an executor, and the engine can go through them one at a time without ever decoding the whole list
+(see computeHullPoints(Executor&, const CompressedPointList&) in hullengine.h).
+
+The same blocks can be saved to and loaded from a file as they are.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+
+#include "point.h"
+#include "executor.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COMPRESSED_POINTS_X86 1
+#else
+#define COMPRESSED_POINTS_X86 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//points per block. small enough that a decoded block (32 KB) stays in L1/L2 while it's being used.
+const uint32_t compressedBlockPoints = 4096;
+
+//the decoder reads up to this many bytes past the end of a block, so the byte buffer always has this much zeroed padding on the end
+const size_t compressedPadding = 16;
+
+const char compressedFileMagic[8] = { 'Q', 'H', 'P', 'A', 'C', 'K', 'E', 'D' };
+const uint32_t compressedFileVersion = 1;
+
+struct CompressedBlock {
+	uint64_t byteOffset;
+	uint32_t count;
+
+	//size of the x differences, which start at byteOffset. the y differences follow straight after.
+	uint32_t xBytes;
+	uint32_t yBytes;
+
+	Point first, last;
+};
+
+struct CompressedFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t blockPoints;
+	uint64_t pointCount;
+	uint64_t blockCount;
+	uint64_t byteCount;
+};
+
+inline uint32_t zigzagEncode(uint32_t difference) {
+	return (difference << 1) ^ (uint32_t)((int32_t)difference >> 31);
+}
+
+inline uint32_t zigzagDecode(uint32_t value) {
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+inline void appendVarint(std::vector<uint8_t>& out, uint32_t value) {
+	while (value >= 0x80) {
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+inline int countTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return (int)index;
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+//decodes count varints into out and returns where they end. may read up to compressedPadding bytes past the last one.
+inline const uint8_t* decodeVarints(const uint8_t* in, uint32_t* out, size_t count) {
+	size_t x = 0;
+#if COMPRESSED_POINTS_X86 == 1
+	while (x + 16 <= count) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)in);
+		uint32_t continued = (uint32_t)_mm_movemask_epi8(bytes);
+
+		//the common case: 16 values of one byte each, widened straight to 32 bits
+		if (continued == 0) {
+			__m128i zero = _mm_setzero_si128();
+			__m128i low = _mm_unpacklo_epi8(bytes, zero);
+			__m128i high = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_si128((__m128i*)(out + x), _mm_unpacklo_epi16(low, zero));
+			_mm_storeu_si128((__m128i*)(out + x + 4), _mm_unpackhi_epi16(low, zero));
+			_mm_storeu_si128((__m128i*)(out + x + 8), _mm_unpacklo_epi16(high, zero));
+			_mm_storeu_si128((__m128i*)(out + x + 12), _mm_unpackhi_epi16(high, zero));
+			in += 16;
+			x += 16;
+			continue;
+		}
+
+		//otherwise the continuation bits say where every value in these 16 bytes ends, so there's no need to test each byte
+		int position = 0;
+		while (x < count) {
+			int length = countTrailingZeros(~(continued >> position)) + 1;
+			if (position + length > 16) {
+				break;
+			}
+			uint32_t value = 0;
+			for (int byte = 0; byte < length; byte++) {
+				value |= (uint32_t)(in[position + byte] & 0x7F) << (7 * byte);
+			}
+			out[x++] = value;
+			position += length;
+		}
+		in += position;
+		if (position == 0) {
+			break;
+		}
+	}
+#endif
+	for (; x < count; x++) {
+		uint32_t value = 0;
+		int shift = 0;
+		uint8_t byte;
+		do {
+			byte = *in++;
+			value |= (uint32_t)(byte & 0x7F) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		out[x] = value;
+	}
+	return in;
+}
+
+//reads count items from the stream a piece at a time, so a corrupt count runs out of data long before it can run out of memory
+template<typename T>
+inline bool readBounded(std::istream& infile, std::vector<T>& out, uint64_t count) {
+	const uint64_t piece = ((uint64_t)1 << 20) / sizeof(T);
+	out.clear();
+	while (out.size() < count) {
+		size_t start = out.size();
+		size_t take = (size_t)std::min<uint64_t>(piece, count - start);
+		out.resize(start + take);
+		if (!infile.read((char*)(out.data() + start), take * sizeof(T))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//checks that bytes holds exactly count varints of at most 5 bytes each, so decoding them can't run past the end
+inline bool validVarints(const uint8_t* in, size_t byteCount, size_t count) {
+	size_t values = 0;
+	int length = 0;
+	for (size_t x = 0; x < byteCount; x++) {
+		length++;
+		if (length > 5) {
+			return false;
+		}
+		if ((in[x] & 0x80) == 0) {
+			values++;
+			length = 0;
+		}
+	}
+	return length == 0 && values == count;
+}
+
+class CompressedPointList {
+private:
+	std::vector<uint8_t> bytes;
+	std::vector<CompressedBlock> blocks;
+	uint32_t blockPoints = compressedBlockPoints;
+	size_t pointCount = 0;
+
+public:
+	CompressedPointList() {}
+
+	//compresses a list sorted with pointLessThan. other orders still work, they just don't compress as well.
+	CompressedPointList(const PointList& sortedPoints, uint32_t pointsPerBlock = compressedBlockPoints) : blockPoints(pointsPerBlock), pointCount(sortedPoints.size()) {
+		bytes.reserve(sortedPoints.size() * 3 + compressedPadding);
+		for (size_t begin = 0; begin < sortedPoints.size(); begin += blockPoints) {
+			size_t end = std::min(sortedPoints.size(), begin + blockPoints);
+			CompressedBlock block;
+			block.byteOffset = bytes.size();
+			block.count = (uint32_t)(end - begin);
+			block.first = sortedPoints[begin];
+			block.last = sortedPoints[end - 1];
+
+			//differences wrap around in 32 bits, so any coordinates round-trip, however far apart
+			for (size_t x = begin + 1; x < end; x++) {
+				appendVarint(bytes, (uint32_t)sortedPoints[x].x - (uint32_t)sortedPoints[x - 1].x);
+			}
+			block.xBytes = (uint32_t)(bytes.size() - block.byteOffset);
+			for (size_t x = begin + 1; x < end; x++) {
+				appendVarint(bytes, zigzagEncode((uint32_t)sortedPoints[x].y - (uint32_t)sortedPoints[x - 1].y));
+			}
+			block.yBytes = (uint32_t)(bytes.size() - block.byteOffset - block.xBytes);
+			blocks.push_back(block);
+		}
+		bytes.resize(bytes.size() + compressedPadding, 0);
+	}
+
+	size_t size() const {
+		return pointCount;
+	}
+
+	bool empty() const {
+		return pointCount == 0;
+	}
+
+	size_t blockCount() const {
+		return blocks.size();
+	}
+
+	uint32_t pointsPerBlock() const {
+		return blockPoints;
+	}
+
+	const CompressedBlock& block(size_t index) const {
+		return blocks[index];
+	}
+
+	Point front() const {
+		return blocks.front().first;
+	}
+
+	Point back() const {
+		return blocks.back().last;
+	}
+
+	//size of the compressed points, including the block table
+	size_t compressedBytes() const {
+		return bytes.size() + blocks.size() * sizeof(CompressedBlock);
+	}
+
+	//decodes one block into out, which needs room for pointsPerBlock() points. returns the amount of points decoded.
+	size_t decodeBlock(size_t index, Point* out) const {
+		const CompressedBlock& current = blocks[index];
+		thread_local std::vector<uint32_t> differences;
+		if (differences.size() < blockPoints) {
+			differences.resize(blockPoints);
+		}
+
+		const uint8_t* in = bytes.data() + current.byteOffset;
+		size_t steps = current.count - 1;
+
+		uint32_t x = (uint32_t)current.first.x;
+		out[0] = current.first;
+		decodeVarints(in, differences.data(), steps);
+		for (size_t point = 0; point < steps; point++) {
+			x += differences[point];
+			out[point + 1].x = (int)x;
+		}
+
+		uint32_t y = (uint32_t)current.first.y;
+		decodeVarints(in + current.xBytes, differences.data(), steps);
+		for (size_t point = 0; point < steps; point++) {
+			y += zigzagDecode(differences[point]);
+			out[point + 1].y = (int)y;
+		}
+		return current.count;
+	}
+
+	//decodes every block, spread over the executor
+	PointList decompress(Executor& exec) const {
+		PointList points;
+		points.resize(pointCount);
+		exec.parallelFor(blocks.size(), [&](size_t begin, size_t end) {
+			for (size_t x = begin; x < end; x++) {
+				decodeBlock(x, points.data() + x * blockPoints);
+			}
+			});
+		return points;
+	}
+
+	//returns false if the file couldn't be written
+	bool save(const std::string& path) const {
+		std::ofstream outfile(path, std::ios::binary | std::ios::trunc);
+		if (!outfile.is_open()) {
+			return false;
+		}
+		return save(outfile);
+	}
+
+	//writes the list at the current position of a stream, so it can be one part of a bigger file
+	bool save(std::ostream& outfile) const {
+		CompressedFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, compressedFileMagic, sizeof(header.magic));
+		header.version = compressedFileVersion;
+		header.blockPoints = blockPoints;
+		header.pointCount = pointCount;
+		header.blockCount = blocks.size();
+		header.byteCount = bytes.size() - compressedPadding;
+
+		outfile.write((const char*)&header, sizeof(header));
+		outfile.write((const char*)blocks.data(), blocks.size() * sizeof(CompressedBlock));
+		outfile.write((const char*)bytes.data(), header.byteCount);
+		outfile.flush();
+		return outfile.good();
+	}
+
+	//returns false, leaving the list empty, if the file can't be read or isn't a valid compressed point file
+	bool load(const std::string& path) {
+		*this = CompressedPointList();
+		std::ifstream infile(path, std::ios::binary);
+		if (!infile.is_open()) {
+			return false;
+		}
+		return load(infile);
+	}
+
+	//reads a list written by save(std::ostream&), leaving the stream just past it
+	bool load(std::istream& infile) {
+		*this = CompressedPointList();
+		CompressedFileHeader header;
+		if (!infile.read((char*)&header, sizeof(header)) || memcmp(header.magic, compressedFileMagic, sizeof(header.magic)) != 0
+			|| header.version != compressedFileVersion || header.blockPoints == 0
+			|| header.blockCount != (header.pointCount + header.blockPoints - 1) / header.blockPoints) {
+			return false;
+		}
+
+		//the counts in the header are only trusted as far as the stream actually backs them up
+		std::vector<CompressedBlock> fileBlocks;
+		std::vector<uint8_t> fileBytes;
+		if (!readBounded(infile, fileBlocks, header.blockCount) || !readBounded(infile, fileBytes, header.byteCount)) {
+			return false;
+		}
+		fileBytes.resize(fileBytes.size() + compressedPadding, 0);
+
+		//every block has to lie inside the bytes and hold the amount of points its position says, or decoding could run off the end
+		for (size_t x = 0; x < fileBlocks.size(); x++) {
+			const CompressedBlock& current = fileBlocks[x];
+			uint64_t expected = std::min<uint64_t>(header.blockPoints, header.pointCount - x * header.blockPoints);
+			if (current.count != expected || current.byteOffset > header.byteCount
+				|| (uint64_t)current.xBytes + current.yBytes > header.byteCount - current.byteOffset) {
+				return false;
+			}
+			const uint8_t* in = fileBytes.data() + current.byteOffset;
+			if (!validVarints(in, current.xBytes, current.count - 1) || !validVarints(in + current.xBytes, current.yBytes, current.count - 1)) {
+				return false;
+			}
+		}
+
+		blocks = std::move(fileBlocks);
+		bytes = std::move(fileBytes);
+		blockPoints = header.blockPoints;
+		pointCount = (size_t)header.pointCount;
+		return true;
+	}
+};
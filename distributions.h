@@ -0,0 +1,148 @@
+#pragma once
+
+/*
+Input distributions, so the engine isn't only ever tried on the easy case.
+
+Points spread evenly over a rectangle end up with a hull of a handful of points near the corners, which Quickhull gets rid of almost everything around in the first split or two.
+The others each stress something different:
+	PD_Disk: evenly over a disk. The hull grows slowly with the count (about n^(1/3)).
+	PD_Circle: on a circle, so nearly every point is on the hull. Rounding to whole coordinates puts some just inside once the circle gets crowded
+		(a million points on a circle 2^30 across, as wide as the engine takes, still leave about a fifth of them on the hull, but one the size of the window only has room for a couple of hundred).
+	PD_Clusters: a few Gaussian clusters at random spots, so most points are packed far inside and the hull comes from the clusters' outskirts.
+	PD_Annulus: evenly over a thin ring. Nothing gets ruled out until the splits get close to the ring, so the recursion carries most points several levels down.
+	PD_NearCollinear: along the diagonal, no more than a unit or so away from it. Lots of points are exactly collinear with the hull edges and every triangle is very thin.
+	PD_Adversarial: Quickhull's worst case. Points are on a circle, packed ever closer to the rightmost point, with as many between every halving of the angle.
+		The furthest point of each split sits in the middle of its arc, so each split only takes one of those slices off and the recursion runs as many levels deep as there are slices,
+		with nearly every point still left at each one.
+
+Every distribution makes point i from block i of a PointGenerator, so they're all seedable, made in parallel, and the same for any thread count (see pointgenerator.h).
+*/
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "point.h"
+#include "executor.h"
+#include "pointgenerator.h"
+
+enum PointDistribution {
+	PD_Uniform,
+	PD_Disk,
+	PD_Circle,
+	PD_Clusters,
+	PD_Annulus,
+	PD_NearCollinear,
+	PD_Adversarial,
+	PD_Count
+};
+
+//how many clusters PD_Clusters makes, and how wide each is as a share of the radius
+const int distributionClusters = 16;
+const double distributionClusterSpread = 0.08;
+
+//inner radius of PD_Annulus as a share of the outer one
+const double distributionAnnulusInner = 0.9;
+
+//how far PD_NearCollinear strays from the diagonal, as a share of its length. never less than one unit.
+const double distributionCollinearJitter = 0.0001;
+
+inline const char* distributionName(PointDistribution distribution) {
+	switch (distribution) {
+	case PD_Uniform: return "uniform";
+	case PD_Disk: return "disk";
+	case PD_Circle: return "circle";
+	case PD_Clusters: return "clusters";
+	case PD_Annulus: return "annulus";
+	case PD_NearCollinear: return "near-collinear";
+	case PD_Adversarial: return "adversarial";
+	default: return "unknown";
+	}
+}
+
+inline PointDistribution nextDistribution(PointDistribution distribution) {
+	return (PointDistribution)((distribution + 1) % PD_Count);
+}
+
+//rounds to the nearest whole point, kept inside bounds
+inline Point distributionRound(double x, double y, const GeneratorBounds& bounds) {
+	Point point;
+	point.x = (int)std::clamp<long long>(std::llround(x), bounds.minX, (long long)bounds.maxX - 1);
+	point.y = (int)std::clamp<long long>(std::llround(y), bounds.minY, (long long)bounds.maxY - 1);
+	return point;
+}
+
+//point number index of the given distribution, fitted into bounds
+inline Point distributionPoint(const PointGenerator& generator, PointDistribution distribution, uint64_t index, const GeneratorBounds& bounds) {
+	const double twoPi = 6.283185307179586;
+	if (distribution == PD_Uniform) {
+		return generator.uniformPoint(index, bounds);
+	}
+
+	//the largest circle that fits in bounds
+	double centerX = ((double)bounds.minX + bounds.maxX - 1) / 2;
+	double centerY = ((double)bounds.minY + bounds.maxY - 1) / 2;
+	double radius = std::min((double)bounds.maxX - 1 - bounds.minX, (double)bounds.maxY - 1 - bounds.minY) / 2;
+
+	PhiloxBlock random = generator.block(index);
+	double first = philoxUnit(philoxWord64(random, 0));
+	double second = philoxUnit(philoxWord64(random, 1));
+
+	switch (distribution) {
+	case PD_Disk: {
+		double distance = radius * std::sqrt(first);
+		return distributionRound(centerX + distance * std::cos(twoPi * second), centerY + distance * std::sin(twoPi * second), bounds);
+	}
+	case PD_Circle:
+		return distributionRound(centerX + radius * std::cos(twoPi * first), centerY + radius * std::sin(twoPi * first), bounds);
+	case PD_Clusters: {
+		//each cluster's center comes from its own block, in a lane no point uses
+		int cluster = (int)philoxBounded(philoxWord64(random, 0), distributionClusters);
+		PhiloxBlock clusterRandom = generator.block((uint64_t)cluster, 1);
+		double spread = radius * distributionClusterSpread;
+		double reach = std::max(0.0, radius - spread * 3);
+		double clusterX = centerX + reach * (philoxUnit(philoxWord64(clusterRandom, 0)) * 2 - 1);
+		double clusterY = centerY + reach * (philoxUnit(philoxWord64(clusterRandom, 1)) * 2 - 1);
+
+		//Box-Muller, from the second half of the block
+		double length = spread * std::sqrt(-2 * std::log((random.word[2] + 1.0) / 4294967296.0));
+		double angle = twoPi * (random.word[3] / 4294967296.0);
+		return distributionRound(clusterX + length * std::cos(angle), clusterY + length * std::sin(angle), bounds);
+	}
+	case PD_Annulus: {
+		double inner = radius * distributionAnnulusInner;
+		double distance = std::sqrt(inner * inner + first * (radius * radius - inner * inner));
+		return distributionRound(centerX + distance * std::cos(twoPi * second), centerY + distance * std::sin(twoPi * second), bounds);
+	}
+	case PD_NearCollinear: {
+		double lengthX = (double)bounds.maxX - 1 - bounds.minX, lengthY = (double)bounds.maxY - 1 - bounds.minY;
+		double length = std::max(1.0, std::sqrt(lengthX * lengthX + lengthY * lengthY));
+		double jitter = std::max(1.0, length * distributionCollinearJitter) * (second * 2 - 1);
+		return distributionRound(bounds.minX + lengthX * first - lengthY / length * jitter, bounds.minY + lengthY * first + lengthX / length * jitter, bounds);
+	}
+	case PD_Adversarial: {
+		//one slice for every halving of the angle, down to where the arc is about a unit long. half the points are mirrored below the center.
+		double slices = std::max(1.0, std::log2(radius * twoPi / 2));
+		double angle = twoPi / 2 * std::exp2(-slices * first);
+		double side = second < 0.5 ? 1 : -1;
+		return distributionRound(centerX + radius * std::cos(angle), centerY + side * radius * std::sin(angle), bounds);
+	}
+	default:
+		return generator.uniformPoint(index, bounds);
+	}
+}
+
+//count points of the given distribution, in index order
+inline PointList distributionPoints(Executor& exec, const PointGenerator& generator, PointDistribution distribution, size_t count, const GeneratorBounds& bounds) {
+	return generatePointList(exec, count, [&](uint64_t index) { return distributionPoint(generator, distribution, index, bounds); });
+}
+
+//the same points as distributionPoints, written as separate x and y columns
+inline void distributionColumns(Executor& exec, const PointGenerator& generator, PointDistribution distribution, size_t count, const GeneratorBounds& bounds, int32_t* xs, int32_t* ys) {
+	generatePointColumns(exec, count, [&](uint64_t index) { return distributionPoint(generator, distribution, index, bounds); }, xs, ys);
+}
+
+//the same points as distributionPoints, already sorted with pointLessThan
+inline PointList sortedDistributionPoints(Executor& exec, const PointGenerator& generator, PointDistribution distribution, size_t count, const GeneratorBounds& bounds) {
+	return generateSortedPoints(exec, count, bounds, [&](uint64_t index) { return distributionPoint(generator, distribution, index, bounds); });
+}
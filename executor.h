@@ -0,0 +1,357 @@
+#pragma once
+
+/*
+Executors decide how the hull engine spreads its work across threads.
+
+The engine only ever asks for two things: running a loop split into chunks (partitioning and the furthest point search),
+and running two independent jobs at once (the two halves of each recursion).
+Every backend implements just those two, so the engine never has to know which one it is running on.
+
+EX_Sequential: everything runs on the calling thread. Use this when already running inside someone else's thread pool.
+EX_StdParallel: std::execution::par. Only available if the standard library was built with parallel algorithm support.
+	GCC's standard library runs it on TBB, so there it's only compiled in when the TBB headers are found, and the program then has to be linked with -ltbb.
+	Define USE_STD_PARALLEL as 0 before including this to leave it out anyway (or as 1 to force it in).
+EX_OpenMP: OpenMP pragmas. Only available if the compiler has OpenMP turned on.
+EX_ThreadPool: a small built-in pool of std::threads, which is always available.
+EX_Fastest: not a backend itself. Tries every available backend on a sample of the input and keeps the quickest (see selectFastestExecutor() in hullengine.h).
+*/
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#if __has_include(<execution>)
+#include <execution>
+#endif
+
+#ifndef USE_STD_PARALLEL
+#if defined(__cpp_lib_parallel_algorithm) && (!defined(__GLIBCXX__) || __has_include(<tbb/version.h>))
+#define USE_STD_PARALLEL 1
+#else
+#define USE_STD_PARALLEL 0
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum ExecutorType {
+	EX_Sequential,
+	EX_StdParallel,
+	EX_OpenMP,
+	EX_ThreadPool,
+	EX_Fastest
+};
+
+class Executor {
+public:
+	virtual ~Executor() {}
+
+	virtual const char* name() const = 0;
+
+	//how many threads this executor can keep busy at once
+	virtual int concurrency() const = 0;
+
+	//calls body(begin, end) for chunks that together cover [0, count). chunks may run at the same time.
+	virtual void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) = 0;
+
+	//runs both jobs, possibly at the same time, and returns once both are finished
+	virtual void invoke(const std::function<void()>& first, const std::function<void()>& second) = 0;
+
+	//how many chunks a loop of count items should be split into, so that no chunk is smaller than grainSize
+	size_t chunkCount(size_t count, size_t grainSize) const {
+		size_t chunks = std::min(count / std::max<size_t>(grainSize, 1), (size_t)concurrency() * 4);
+		return std::max<size_t>(chunks, 1);
+	}
+};
+
+//gives the range of items covered by one chunk, with the remainder spread over the first few chunks
+inline void chunkBounds(size_t count, size_t chunks, size_t chunk, size_t& begin, size_t& end) {
+	size_t base = count / chunks;
+	size_t extra = count % chunks;
+	begin = chunk * base + std::min(chunk, extra);
+	end = begin + base + (chunk < extra ? 1 : 0);
+}
+
+class SequentialExecutor : public Executor {
+public:
+	const char* name() const override { return "sequential"; }
+	int concurrency() const override { return 1; }
+
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) override {
+		if (count > 0) {
+			body(0, count);
+		}
+	}
+
+	void invoke(const std::function<void()>& first, const std::function<void()>& second) override {
+		first();
+		second();
+	}
+};
+
+#if USE_STD_PARALLEL == 1
+class StdParallelExecutor : public Executor {
+public:
+	const char* name() const override { return "std::execution::par"; }
+	int concurrency() const override { return std::max(1, (int)std::thread::hardware_concurrency()); }
+
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) override {
+		if (count == 0) {
+			return;
+		}
+		size_t chunks = std::min(count, (size_t)concurrency());
+		std::vector<size_t> chunkIndices(chunks);
+		for (size_t x = 0; x < chunks; x++) {
+			chunkIndices[x] = x;
+		}
+		std::for_each(std::execution::par, chunkIndices.begin(), chunkIndices.end(), [&](size_t chunk) {
+			size_t begin, end;
+			chunkBounds(count, chunks, chunk, begin, end);
+			body(begin, end);
+			});
+	}
+
+	void invoke(const std::function<void()>& first, const std::function<void()>& second) override {
+		const std::function<void()>* jobs[2] = { &first, &second };
+		std::for_each(std::execution::par, jobs, jobs + 2, [](const std::function<void()>* job) {
+			(*job)();
+			});
+	}
+};
+#endif
+
+#ifdef _OPENMP
+class OpenMPExecutor : public Executor {
+public:
+	const char* name() const override { return "OpenMP"; }
+	int concurrency() const override { return omp_get_max_threads(); }
+
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) override {
+		if (count == 0) {
+			return;
+		}
+		int chunks = (int)std::min(count, (size_t)concurrency());
+
+#if _OPENMP >= 201511
+		//inside a recursion task a nested parallel region would only get one thread, so split the loop into tasks instead
+		if (omp_in_parallel()) {
+#pragma omp taskloop
+			for (int chunk = 0; chunk < chunks; chunk++) {
+				size_t begin, end;
+				chunkBounds(count, chunks, chunk, begin, end);
+				body(begin, end);
+			}
+			return;
+		}
+#endif
+
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int chunk = 0; chunk < chunks; chunk++) {
+			size_t begin, end;
+			chunkBounds(count, chunks, chunk, begin, end);
+			body(begin, end);
+		}
+	}
+
+	void invoke(const std::function<void()>& first, const std::function<void()>& second) override {
+#if _OPENMP >= 200805
+		//tasks need an enclosing parallel region, so the outermost call opens one and every nested call reuses it
+		if (omp_in_parallel()) {
+#pragma omp task untied
+			first();
+			second();
+#pragma omp taskwait
+		}
+		else {
+#pragma omp parallel
+#pragma omp single
+			{
+#pragma omp task untied
+				first();
+				second();
+#pragma omp taskwait
+			}
+		}
+#else
+		//OpenMP 2.0 (MSVC's default) has no tasks, so only the outermost split runs in parallel
+#pragma omp parallel sections
+		{
+#pragma omp section
+			first();
+#pragma omp section
+			second();
+		}
+#endif
+	}
+};
+#endif
+
+//built-in pool of worker threads. waiting threads run queued jobs themselves, so nested invoke() calls can't deadlock.
+class ThreadPoolExecutor : public Executor {
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex queueLock;
+	std::condition_variable queueSignal;
+	bool stopping = false;
+
+	void submit(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(queueLock);
+			tasks.push_back(std::move(task));
+		}
+		queueSignal.notify_one();
+	}
+
+	bool runPendingTask() {
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock(queueLock);
+			if (tasks.empty()) {
+				return false;
+			}
+			task = std::move(tasks.back());
+			tasks.pop_back();
+		}
+		task();
+		return true;
+	}
+
+	void waitFor(const std::atomic<int>& remaining) {
+		while (remaining.load() > 0) {
+			if (!runPendingTask()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(queueLock);
+				queueSignal.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if (tasks.empty()) {
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+public:
+	ThreadPoolExecutor(int threadCount = 0) {
+		if (threadCount <= 0) {
+			threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+		}
+		//the calling thread always does work too, so it counts as one of the threads
+		for (int x = 1; x < threadCount; x++) {
+			workers.emplace_back([this] { workerLoop(); });
+		}
+	}
+
+	~ThreadPoolExecutor() {
+		{
+			std::lock_guard<std::mutex> lock(queueLock);
+			stopping = true;
+		}
+		queueSignal.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	const char* name() const override { return "thread pool"; }
+	int concurrency() const override { return (int)workers.size() + 1; }
+
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) override {
+		if (count == 0) {
+			return;
+		}
+		size_t chunks = std::min(count, (size_t)concurrency());
+		if (chunks == 1) {
+			body(0, count);
+			return;
+		}
+
+		//chunks are handed out through a shared counter, so whichever threads show up first do the work
+		std::atomic<size_t> nextChunk(0);
+		auto runChunks = [&]() {
+			size_t chunk;
+			while ((chunk = nextChunk++) < chunks) {
+				size_t begin, end;
+				chunkBounds(count, chunks, chunk, begin, end);
+				body(begin, end);
+			}
+		};
+
+		//helpers refer to this stack frame, so every one of them has to finish before returning
+		std::atomic<int> helpersLeft((int)chunks - 1);
+		for (size_t x = 1; x < chunks; x++) {
+			submit([&]() {
+				runChunks();
+				helpersLeft--;
+				});
+		}
+		runChunks();
+		waitFor(helpersLeft);
+	}
+
+	void invoke(const std::function<void()>& first, const std::function<void()>& second) override {
+		std::atomic<int> secondLeft(1);
+		submit([&]() {
+			second();
+			secondLeft--;
+			});
+		first();
+		waitFor(secondLeft);
+	}
+};
+
+inline bool isExecutorAvailable(ExecutorType type) {
+	switch (type) {
+	case EX_StdParallel:
+#if USE_STD_PARALLEL == 1
+		return true;
+#else
+		return false;
+#endif
+	case EX_OpenMP:
+#ifdef _OPENMP
+		return true;
+#else
+		return false;
+#endif
+	default:
+		return true;
+	}
+}
+
+//creates a backend of the given type, falling back to the thread pool if that type wasn't compiled in.
+//EX_Fastest needs a sample of the input to time, so it's handled by selectFastestExecutor() instead.
+inline std::unique_ptr<Executor> createExecutor(ExecutorType type) {
+	switch (type) {
+	case EX_Sequential:
+		return std::make_unique<SequentialExecutor>();
+#if USE_STD_PARALLEL == 1
+	case EX_StdParallel:
+		return std::make_unique<StdParallelExecutor>();
+#endif
+#ifdef _OPENMP
+	case EX_OpenMP:
+		return std::make_unique<OpenMPExecutor>();
+#endif
+	default:
+		return std::make_unique<ThreadPoolExecutor>();
+	}
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+/*
+Grouped hulls: one hull per key over a single big set of labeled points, like one per vehicle or one per cell ID.
+
+Going through the QuickHull class once per group would mean picking each group's points out, allocating and sorting them separately every time.
+Instead the records are put in key order with a parallel LSD radix sort, which is stable and only makes one pass per byte of the key that actually differs
+between records (keys that only ever use their low 16 bits take two passes, not eight).
+That leaves each group's points next to each other, so the groups' hulls are then worked out in parallel, each straight from its own range:
+	groups of up to 32 points go to the small kernels (see smallhull.h) without being sorted or put in a list,
+	other groups are sorted into a buffer every thread keeps and reuses, then run through the engine on that thread,
+	and the few groups big enough to be worth splitting up themselves get the whole executor, one after the other.
+
+The result is one flat list of hull points, each group's hull in order around it (see orderHull), with an offset per key saying where its hull starts.
+*/
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "point.h"
+#include "executor.h"
+#include "hullengine.h"
+#include "smallhull.h"
+
+//bits of the key sorted per radix pass
+const int groupedHullRadixBits = 8;
+
+//records per chunk for the radix passes
+const size_t groupedHullGrainSize = 65536;
+
+//groups with at least this many points get the whole executor to themselves, instead of one thread
+const size_t groupedHullParallelGroup = 1 << 20;
+
+//one labeled input point
+struct KeyedPoint {
+	uint64_t key;
+	Point point;
+};
+
+struct GroupedHulls {
+	//every key that had any points, in increasing order
+	std::vector<uint64_t> keys;
+
+	//group x's hull is hullPoints[offsets[x], offsets[x + 1]). there's one more offset than there are keys.
+	std::vector<size_t> offsets;
+
+	//every group's hull, one after the other
+	std::vector<Point> hullPoints;
+
+	size_t size() const {
+		return keys.size();
+	}
+
+	//the group with the given key, or size() if no point had it
+	size_t find(uint64_t key) const {
+		std::vector<uint64_t>::const_iterator match = std::lower_bound(keys.begin(), keys.end(), key);
+		return match != keys.end() && *match == key ? match - keys.begin() : keys.size();
+	}
+
+	const Point* hullBegin(size_t group) const {
+		return hullPoints.data() + offsets[group];
+	}
+
+	size_t hullSize(size_t group) const {
+		return offsets[group + 1] - offsets[group];
+	}
+};
+
+//puts the records in key order, keeping records with the same key in the order they were given
+inline void radixSortByKey(Executor& exec, std::vector<KeyedPoint>& records) {
+	const size_t buckets = (size_t)1 << groupedHullRadixBits;
+	const uint64_t digitMask = buckets - 1;
+	size_t count = records.size();
+	if (count < 2) {
+		return;
+	}
+
+	//the bits that differ from the first key somewhere. digits that never differ would leave every record where it is, so their passes are skipped.
+	size_t chunks = exec.chunkCount(count, groupedHullGrainSize);
+	std::vector<uint64_t> chunkVarying(chunks, 0);
+	uint64_t firstKey = records[0].key;
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			chunkBounds(count, chunks, chunk, begin, end);
+			uint64_t varying = 0;
+			for (size_t x = begin; x < end; x++) {
+				varying |= records[x].key ^ firstKey;
+			}
+			chunkVarying[chunk] = varying;
+		}
+		});
+	uint64_t varying = 0;
+	for (uint64_t chunkBits : chunkVarying) {
+		varying |= chunkBits;
+	}
+
+	std::vector<KeyedPoint> scratch(count);
+	std::vector<size_t> offsets(chunks * buckets);
+	for (int shift = 0; shift < 64; shift += groupedHullRadixBits) {
+		if (((varying >> shift) & digitMask) == 0) {
+			continue;
+		}
+
+		//count each chunk's digits
+		std::fill(offsets.begin(), offsets.end(), 0);
+		exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+			for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+				size_t begin, end;
+				chunkBounds(count, chunks, chunk, begin, end);
+				size_t* chunkCounts = &offsets[chunk * buckets];
+				for (size_t x = begin; x < end; x++) {
+					chunkCounts[(records[x].key >> shift) & digitMask]++;
+				}
+			}
+			});
+
+		//turn the counts into where each chunk writes each digit: digit by digit, and chunk by chunk inside a digit, which keeps the sort stable
+		size_t total = 0;
+		for (size_t digit = 0; digit < buckets; digit++) {
+			for (size_t chunk = 0; chunk < chunks; chunk++) {
+				size_t digitCount = offsets[chunk * buckets + digit];
+				offsets[chunk * buckets + digit] = total;
+				total += digitCount;
+			}
+		}
+
+		exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+			for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+				size_t begin, end;
+				chunkBounds(count, chunks, chunk, begin, end);
+				size_t* chunkOffsets = &offsets[chunk * buckets];
+				for (size_t x = begin; x < end; x++) {
+					scratch[chunkOffsets[(records[x].key >> shift) & digitMask]++] = records[x];
+				}
+			}
+			});
+		records.swap(scratch);
+	}
+}
+
+//the hull of every key's points, all at once. the records don't need to be in any order, and are left sorted by key.
+inline GroupedHulls computeGroupedHulls(Executor& exec, std::vector<KeyedPoint>& records) {
+	GroupedHulls result;
+	radixSortByKey(exec, records);
+
+	//where each group starts in the sorted records, with one extra at the end
+	std::vector<size_t> groupStarts;
+	for (size_t x = 0; x < records.size(); x++) {
+		if (x == 0 || records[x].key != records[x - 1].key) {
+			groupStarts.push_back(x);
+			result.keys.push_back(records[x].key);
+		}
+	}
+	groupStarts.push_back(records.size());
+	size_t groups = result.keys.size();
+
+	//each chunk of groups writes its hulls one after the other into its own list, so the results don't need a list per group.
+	//a group's hull is the hullSizes[group] points that come after the ones of every earlier group in its chunk.
+	std::vector<size_t> hullSizes(groups, 0);
+	size_t chunks = exec.chunkCount(groups, 1);
+	std::vector<std::vector<Point>> chunkHulls(chunks);
+	std::vector<size_t> largeGroups;
+	for (size_t group = 0; group < groups; group++) {
+		if (groupStarts[group + 1] - groupStarts[group] >= groupedHullParallelGroup) {
+			largeGroups.push_back(group);
+		}
+	}
+
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		SequentialExecutor inner;
+		PointList sorted;
+		std::vector<Point> hull;
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			chunkBounds(groups, chunks, chunk, begin, end);
+			std::vector<Point>& hulls = chunkHulls[chunk];
+			for (size_t group = begin; group < end; group++) {
+				size_t groupSize = groupStarts[group + 1] - groupStarts[group];
+				const KeyedPoint* groupRecords = records.data() + groupStarts[group];
+				if (groupSize >= groupedHullParallelGroup) {
+					continue;
+				}
+
+				if (groupSize <= (size_t)smallHullLimit) {
+					Point points[smallHullLimit];
+					for (size_t x = 0; x < groupSize; x++) {
+						points[x] = groupRecords[x].point;
+					}
+					hull.resize(groupSize);
+					hull.resize(smallHullPoints(points, (int)groupSize, hull.data()));
+				}
+				else {
+					sorted.resize(groupSize);
+					for (size_t x = 0; x < groupSize; x++) {
+						sorted[x] = groupRecords[x].point;
+					}
+					std::sort(sorted.begin(), sorted.end(), pointLessThan);
+					hull = computeHullPoints(inner, sorted);
+				}
+				hull = orderHull(std::move(hull));
+				hullSizes[group] = hull.size();
+				hulls.insert(hulls.end(), hull.begin(), hull.end());
+			}
+		}
+		});
+
+	//the big groups split their own work across the executor instead
+	std::vector<std::vector<Point>> largeHulls(largeGroups.size());
+	for (size_t x = 0; x < largeGroups.size(); x++) {
+		size_t group = largeGroups[x];
+		PointList sorted(groupStarts[group + 1] - groupStarts[group]);
+		const KeyedPoint* groupRecords = records.data() + groupStarts[group];
+		exec.parallelFor(sorted.size(), [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; y++) {
+				sorted[y] = groupRecords[y].point;
+			}
+			});
+		std::sort(sorted.begin(), sorted.end(), pointLessThan);
+		largeHulls[x] = orderHull(computeHullPoints(exec, sorted));
+		hullSizes[group] = largeHulls[x].size();
+	}
+
+	result.offsets.resize(groups + 1);
+	result.offsets[0] = 0;
+	for (size_t group = 0; group < groups; group++) {
+		result.offsets[group + 1] = result.offsets[group] + hullSizes[group];
+	}
+	result.hullPoints.resize(result.offsets[groups]);
+
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			chunkBounds(groups, chunks, chunk, begin, end);
+			const Point* hulls = chunkHulls[chunk].data();
+			for (size_t group = begin; group < end; group++) {
+				if (groupStarts[group + 1] - groupStarts[group] < groupedHullParallelGroup) {
+					std::copy(hulls, hulls + hullSizes[group], result.hullPoints.begin() + result.offsets[group]);
+					hulls += hullSizes[group];
+				}
+			}
+		}
+		});
+	for (size_t x = 0; x < largeGroups.size(); x++) {
+		std::copy(largeHulls[x].begin(), largeHulls[x].end(), result.hullPoints.begin() + result.offsets[largeGroups[x]]);
+	}
+	return result;
+}
@@ -0,0 +1,364 @@
+#pragma once
+
+/*
+An on-disk cache of finished hulls, for batch jobs that keep computing the hull of the same input.
+
+Inputs are identified by XXH64 (xxHash) of their points, exactly as they came in (before sorting), seeded with hullCacheVersion,
+so a change that could give different hulls only needs that number bumped to leave every old entry unused.
+None of the engine's settings go into the key, since none of them change the result: the executor, its thread count, tiling (useTiledHull) and the grain sizes
+only change how the work is split up, and every one of them gives the same hull (the benchmarks check this). A setting that did change it would have to be hashed in too.
+Each cached hull is one small file in the cache directory, named after the hash, holding the point count (checked on lookup as a guard against collisions) and the ordered hull.
+
+Lookups touch a file's modification time, so the oldest time is always the least recently used entry.
+Whenever a new hull is stored and the directory goes over its size limit, the least recently used entries are deleted until it fits again.
+
+Hits and misses are counted for the current run and also kept in the directory, so the hit rate covers every run that used the same cache.
+Several processes (and threads, in batch mode) can share a cache: the totals are only updated while holding a lock on "stats.lock",
+and every entry is written under a temporary name of its own before being renamed into place.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <atomic>
+#include <system_error>
+#include <filesystem>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <process.h>
+#include <thread>
+#include <chrono>
+#else
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "point.h"
+
+//bump this whenever a change could make the engine return a different hull for the same input
+const uint64_t hullCacheVersion = 1;
+
+const char* const hullCacheDefaultDirectory = "hull_cache";
+
+//total size the cache directory is kept under
+const uintmax_t hullCacheMaxBytes = 256ull * 1024 * 1024;
+
+const uint32_t hullCacheMagic = 0x43485148; //'HQHC'
+
+inline uint64_t xxh64Rotate(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t xxh64Read64(const unsigned char* bytes) {
+	uint64_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+inline uint32_t xxh64Read32(const unsigned char* bytes) {
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+//XXH64 of size bytes (the reference algorithm, assuming a little-endian machine)
+inline uint64_t xxh64(const void* data, size_t size, uint64_t seed) {
+	const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+	const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+	const uint64_t prime3 = 0x165667B19E3779F9ull;
+	const uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+	const uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+	auto round = [&](uint64_t accumulator, uint64_t input) {
+		accumulator += input * prime2;
+		accumulator = xxh64Rotate(accumulator, 31);
+		return accumulator * prime1;
+	};
+	auto mergeRound = [&](uint64_t accumulator, uint64_t value) {
+		accumulator ^= round(0, value);
+		return accumulator * prime1 + prime4;
+	};
+
+	const unsigned char* bytes = (const unsigned char*)data;
+	const unsigned char* end = bytes + size;
+	uint64_t hash;
+
+	if (size >= 32) {
+		//four independent lanes over 32-byte stripes
+		uint64_t lane1 = seed + prime1 + prime2;
+		uint64_t lane2 = seed + prime2;
+		uint64_t lane3 = seed;
+		uint64_t lane4 = seed - prime1;
+		const unsigned char* lastStripe = end - 32;
+		do {
+			lane1 = round(lane1, xxh64Read64(bytes));
+			lane2 = round(lane2, xxh64Read64(bytes + 8));
+			lane3 = round(lane3, xxh64Read64(bytes + 16));
+			lane4 = round(lane4, xxh64Read64(bytes + 24));
+			bytes += 32;
+		} while (bytes <= lastStripe);
+
+		hash = xxh64Rotate(lane1, 1) + xxh64Rotate(lane2, 7) + xxh64Rotate(lane3, 12) + xxh64Rotate(lane4, 18);
+		hash = mergeRound(hash, lane1);
+		hash = mergeRound(hash, lane2);
+		hash = mergeRound(hash, lane3);
+		hash = mergeRound(hash, lane4);
+	}
+	else {
+		hash = seed + prime5;
+	}
+	hash += size;
+
+	while (bytes + 8 <= end) {
+		hash ^= round(0, xxh64Read64(bytes));
+		hash = xxh64Rotate(hash, 27) * prime1 + prime4;
+		bytes += 8;
+	}
+	if (bytes + 4 <= end) {
+		hash ^= (uint64_t)xxh64Read32(bytes) * prime1;
+		hash = xxh64Rotate(hash, 23) * prime2 + prime3;
+		bytes += 4;
+	}
+	while (bytes < end) {
+		hash ^= (*bytes) * prime5;
+		hash = xxh64Rotate(hash, 11) * prime1;
+		bytes++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+struct HullCacheFileHeader {
+	uint32_t magic;
+	uint32_t hullCount;
+	uint64_t version;
+	uint64_t pointCount;
+	uint64_t key;
+};
+
+//holds an exclusive lock on a file for as long as it's alive, across processes as well as threads
+class HullCacheLock {
+private:
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+#else
+	int file = -1;
+#endif
+
+public:
+	HullCacheLock(const std::filesystem::path& path) {
+#if defined(_WIN32)
+		//a file opened without sharing can't be opened again until it's closed, so opening it is taking the lock
+		for (int attempt = 0; attempt < 1000 && file == INVALID_HANDLE_VALUE; attempt++) {
+			file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+#else
+		file = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (file >= 0 && flock(file, LOCK_EX) != 0) {
+			close(file);
+			file = -1;
+		}
+#endif
+	}
+
+	HullCacheLock(const HullCacheLock&) = delete;
+	HullCacheLock& operator=(const HullCacheLock&) = delete;
+
+	~HullCacheLock() {
+#if defined(_WIN32)
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+#else
+		if (file >= 0) {
+			flock(file, LOCK_UN);
+			close(file);
+		}
+#endif
+	}
+
+	bool locked() const {
+#if defined(_WIN32)
+		return file != INVALID_HANDLE_VALUE;
+#else
+		return file >= 0;
+#endif
+	}
+};
+
+class HullCache {
+private:
+	std::filesystem::path directory;
+	uintmax_t maxBytes;
+	std::atomic<size_t> hits{ 0 };
+	std::atomic<size_t> misses{ 0 };
+
+	//makes temporary names unique between threads. the process id makes them unique between processes.
+	std::atomic<uint64_t> temporaryCount{ 0 };
+
+	std::filesystem::path entryPath(uint64_t key) const {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.hull", (unsigned long long)key);
+		return directory / name;
+	}
+
+	//adds this lookup to the totals kept in the directory. a lookup that can't get the lock just isn't counted there.
+	void countLookup(bool hit) {
+		HullCacheLock lock(directory / "stats.lock");
+		if (!lock.locked()) {
+			return;
+		}
+		std::filesystem::path statsPath = directory / "stats.txt";
+		uint64_t totalHits = 0, totalMisses = 0;
+		{
+			std::ifstream infile(statsPath);
+			infile >> totalHits >> totalMisses;
+		}
+		(hit ? totalHits : totalMisses)++;
+		std::ofstream outfile(statsPath, std::ios::trunc);
+		outfile << totalHits << " " << totalMisses << '\n';
+	}
+
+	//deletes the least recently used entries until the directory fits under maxBytes
+	void evict() {
+		struct Entry {
+			std::filesystem::path path;
+			std::filesystem::file_time_type used;
+			uintmax_t size;
+		};
+		std::vector<Entry> entries;
+		uintmax_t total = 0;
+		std::error_code error;
+		for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error)) {
+			if (file.path().extension() != ".hull") {
+				continue;
+			}
+			Entry entry = { file.path(), file.last_write_time(error), file.file_size(error) };
+			if (error) {
+				continue;
+			}
+			total += entry.size;
+			entries.push_back(entry);
+		}
+		if (total <= maxBytes) {
+			return;
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& left, const Entry& right) { return left.used < right.used; });
+		for (const Entry& entry : entries) {
+			if (total <= maxBytes) {
+				break;
+			}
+			if (std::filesystem::remove(entry.path, error)) {
+				total -= entry.size;
+			}
+		}
+	}
+
+public:
+	HullCache(const std::string& cacheDirectory = hullCacheDefaultDirectory, uintmax_t cacheMaxBytes = hullCacheMaxBytes) : directory(cacheDirectory), maxBytes(cacheMaxBytes) {
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+	}
+
+	//the key an input is cached under. points have to be given in the order they came in, since the hash covers their order too.
+	uint64_t key(const PointList& points) const {
+		return xxh64(points.data(), points.size() * sizeof(Point), hullCacheVersion);
+	}
+
+	//fetches the ordered hull cached for key. returns false on a miss.
+	bool lookup(uint64_t key, size_t pointCount, std::vector<Point>& hull) {
+		std::filesystem::path path = entryPath(key);
+		std::ifstream infile(path, std::ios::binary);
+		HullCacheFileHeader header;
+		bool hit = infile.is_open() && infile.read((char*)&header, sizeof(header)) && header.magic == hullCacheMagic
+			&& header.version == hullCacheVersion && header.key == key && header.pointCount == pointCount && header.hullCount <= pointCount;
+		if (hit) {
+			hull.resize(header.hullCount);
+			hit = (bool)infile.read((char*)hull.data(), hull.size() * sizeof(Point));
+		}
+		infile.close();
+
+		if (hit) {
+			//mark it as recently used
+			std::error_code error;
+			std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+			hits++;
+		}
+		else {
+			misses++;
+		}
+		countLookup(hit);
+		return hit;
+	}
+
+	//caches an ordered hull under key. returns false if it couldn't be written.
+	bool store(uint64_t key, size_t pointCount, const std::vector<Point>& hull) {
+		HullCacheFileHeader header = { hullCacheMagic, (uint32_t)hull.size(), hullCacheVersion, pointCount, key };
+
+		//written under a temporary name first, so another process never sees half an entry
+		std::filesystem::path path = entryPath(key);
+		std::filesystem::path temporary = path;
+#if defined(_WIN32)
+		unsigned long long processId = (unsigned long long)_getpid();
+#else
+		unsigned long long processId = (unsigned long long)getpid();
+#endif
+		char suffix[64];
+		snprintf(suffix, sizeof(suffix), ".%llu.%llu.tmp", processId, (unsigned long long)temporaryCount++);
+		temporary += suffix;
+		std::error_code error;
+		{
+			std::ofstream outfile(temporary, std::ios::binary | std::ios::trunc);
+			if (!outfile.is_open()) {
+				return false;
+			}
+			outfile.write((const char*)&header, sizeof(header));
+			outfile.write((const char*)hull.data(), hull.size() * sizeof(Point));
+			if (!outfile.good()) {
+				outfile.close();
+				std::filesystem::remove(temporary, error);
+				return false;
+			}
+		}
+		std::filesystem::rename(temporary, path, error);
+		if (error) {
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		evict();
+		return true;
+	}
+
+	//prints this run's hit rate along with the rate over every run that used the directory
+	void printReport() {
+		uint64_t totalHits = 0, totalMisses = 0;
+		{
+			HullCacheLock lock(directory / "stats.lock");
+			std::ifstream infile(directory / "stats.txt");
+			infile >> totalHits >> totalMisses;
+		}
+		size_t hits = this->hits, misses = this->misses;
+		size_t lookups = hits + misses;
+		uint64_t totalLookups = totalHits + totalMisses;
+		printf("Hull cache: %zu hits, %zu misses this run (%.1f%% hit rate), %.1f%% over %llu lookups in total\n",
+			hits, misses, lookups > 0 ? 100.0 * hits / lookups : 0.0, totalLookups > 0 ? 100.0 * totalHits / totalLookups : 0.0, (unsigned long long)totalLookups);
+	}
+};
@@ -0,0 +1,411 @@
+#pragma once
+
+/*
+The non-visual hull engine.
+
+This is the same Quickhull that step() performs, but written as plain recursion instead of being broken up into steps,
+and with its loops handed to an Executor (see executor.h) so that they can be spread across threads.
+It's what gets used when there's nothing to draw, since none of the state that step() keeps around is needed.
+*/
+
+#include <vector>
+#include <chrono>
+#include <memory>
+
+#include "trace.h"
+#include "perfcounters.h"
+#include "point.h"
+#include "segmentclassifier.h"
+#include "executor.h"
+#include "smallhull.h"
+#include "blockedpartition.h"
+#include "compressedpoints.h"
+
+//smallest amount of points worth handing to another thread in a loop
+const size_t engineGrainSize = 16384;
+
+//subproblems with fewer points than this recurse on the current thread instead of spawning
+const size_t engineSerialCutoff = 4096;
+
+//finds the point furthest from the line. every point in the list is expected to be on the right of it.
+//ties go to the earliest point in the list, same as QuickHull::calculateFurthestPoint.
+inline Point findFurthestPoint(Executor& exec, Point segmentA, Point segmentB, const PointList& list) {
+	TRACE_SCOPE("calculateFurthestPoint");
+	size_t chunks = exec.chunkCount(list.size(), engineGrainSize);
+	std::vector<size_t> chunkBest(chunks, 0);
+	std::vector<long long> chunkMax(chunks, -1);
+	SegmentClassifier line(segmentA, segmentB);
+
+	exec.parallelFor(chunks, [&](size_t firstChunk, size_t lastChunk) {
+		for (size_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+			size_t begin, end;
+			chunkBounds(list.size(), chunks, chunk, begin, end);
+			PERF_SCOPE("furthest point search", end - begin);
+			for (size_t x = begin; x < end; x++) {
+				long long distance = -line.side(list[x]);
+				if (distance > chunkMax[chunk]) {
+					chunkMax[chunk] = distance;
+					chunkBest[chunk] = x;
+				}
+			}
+		}
+		});
+
+	//chunks are in list order, so a strict comparison keeps the earliest of any ties
+	size_t best = 0;
+	for (size_t chunk = 1; chunk < chunks; chunk++) {
+		if (chunkMax[chunk] > chunkMax[best]) {
+			best = chunk;
+		}
+	}
+	return list[chunkBest[best]];
+}
+
+//the plain partition loop: adds the points of list[0, count) right of lineOne to outOne, and the rest of the ones right of lineTwo to outTwo.
+//furthestOne and furthestTwo track the furthest point added to each, as an index into it.
+inline void partitionRange(const SegmentClassifier& lineOne, const SegmentClassifier& lineTwo, const Point* list, size_t count,
+	PointList& outOne, PointList& outTwo, FurthestTracker& furthestOne, FurthestTracker& furthestTwo) {
+	for (size_t x = 0; x < count; x++) {
+		long long determinantOne = lineOne.side(list[x]);
+		if (determinantOne < 0) {
+			if (-determinantOne > furthestOne.distance) {
+				furthestOne.distance = -determinantOne;
+				furthestOne.index = outOne.size();
+			}
+			outOne.push_back(list[x]);
+			continue;
+		}
+		long long determinantTwo = lineTwo.side(list[x]);
+		if (determinantTwo < 0) {
+			if (-determinantTwo > furthestTwo.distance) {
+				furthestTwo.distance = -determinantTwo;
+				furthestTwo.index = outTwo.size();
+			}
+			outTwo.push_back(list[x]);
+		}
+	}
+}
+
+//joins the per-chunk outputs of a partition (given in list order) into the two final lists, and picks the furthest point of each
+inline void mergePartitionChunks(std::vector<PointList>& chunkOne, std::vector<PointList>& chunkTwo,
+	const std::vector<FurthestTracker>& chunkFurthestOne, const std::vector<FurthestTracker>& chunkFurthestTwo,
+	PointList& setOne, PointList& setTwo, Point& furthestOne, Point& furthestTwo) {
+	size_t chunks = chunkOne.size();
+
+	//chunks are in list order, so a strict comparison keeps the earliest of any ties, same as findFurthestPoint
+	size_t bestOne = 0, bestTwo = 0;
+	for (size_t chunk = 1; chunk < chunks; chunk++) {
+		if (chunkFurthestOne[chunk].distance > chunkFurthestOne[bestOne].distance) {
+			bestOne = chunk;
+		}
+		if (chunkFurthestTwo[chunk].distance > chunkFurthestTwo[bestTwo].distance) {
+			bestTwo = chunk;
+		}
+	}
+	if (chunkFurthestOne[bestOne].distance >= 0) {
+		furthestOne = chunkOne[bestOne][chunkFurthestOne[bestOne].index];
+	}
+	if (chunkFurthestTwo[bestTwo].distance >= 0) {
+		furthestTwo = chunkTwo[bestTwo][chunkFurthestTwo[bestTwo].index];
+	}
+
+	if (chunks == 1) {
+		setOne = std::move(chunkOne[0]);
+		setTwo = std::move(chunkTwo[0]);
+		return;
+	}
+
+	size_t totalOne = 0, totalTwo = 0;
+	for (size_t chunk = 0; chunk < chunks; chunk++) {
+		totalOne += chunkOne[chunk].size();
+		totalTwo += chunkTwo[chunk].size();
+	}
+	setOne.clear();
+	setTwo.clear();
+	setOne.reserve(totalOne);
+	setTwo.reserve(totalTwo);
+	for (size_t chunk = 0; chunk < chunks; chunk++) {
+		setOne.insert(setOne.end(), chunkOne[chunk].begin(), chunkOne[chunk].end());
+		setTwo.insert(setTwo.end(), chunkTwo[chunk].begin(), chunkTwo[chunk].end());
+	}
+}
+
+//splits the points into the ones right of P->C and the ones right of C->Q, keeping both lists in their original order.
+//also finds the furthest point of each new list from its own line, since that's the same determinant. those are only meaningful if the list isn't empty.
+inline void partitionAroundPoint(Executor& exec, Point P, Point Q, Point C, const PointList& list, PointList& setOne, PointList& setTwo, Point& furthestOne, Point& furthestTwo) {
+	TRACE_SCOPE(list.size() >= blockedPartitionThreshold ? "partition (blocked)" : "partition");
+	bool blocked = list.size() >= blockedPartitionThreshold;
+
+	//blocked chunks are whole tiles, so that every thread's share starts on a tile boundary
+	size_t chunks = exec.chunkCount(list.size(), blocked ? partitionTilePoints : engineGrainSize);
+	std::vector<PointList> chunkOne(chunks), chunkTwo(chunks);
+	std::vector<FurthestTracker> chunkFurthestOne(chunks), chunkFurthestTwo(chunks);
+	SegmentClassifier lineOne(P, C), lineTwo(C, Q);
+
+	exec.parallelFor(chunks, [&](size_t firstChunk, size_t lastChunk) {
+		for (size_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+			size_t begin, end;
+			chunkBounds(list.size(), chunks, chunk, begin, end);
+			PERF_SCOPE(blocked ? "partition (blocked)" : "partition", end - begin);
+
+			if (blocked) {
+				//outputs are sized for the worst case and trimmed afterwards; the allocator leaves them uninitialized
+				size_t countOne, countTwo;
+				chunkOne[chunk].resize(end - begin);
+				chunkTwo[chunk].resize(end - begin);
+				partitionBlocked(P, Q, C, list.data() + begin, end - begin, chunkOne[chunk].data(), chunkTwo[chunk].data(),
+					countOne, countTwo, chunkFurthestOne[chunk], chunkFurthestTwo[chunk]);
+				chunkOne[chunk].resize(countOne);
+				chunkTwo[chunk].resize(countTwo);
+				continue;
+			}
+
+			partitionRange(lineOne, lineTwo, list.data() + begin, end - begin, chunkOne[chunk], chunkTwo[chunk], chunkFurthestOne[chunk], chunkFurthestTwo[chunk]);
+		}
+		});
+
+	mergePartitionChunks(chunkOne, chunkTwo, chunkFurthestOne, chunkFurthestTwo, setOne, setTwo, furthestOne, furthestTwo);
+}
+
+//one level of recursion: adds the furthest point from the line (already found while splitting the parent), then recurses on both of the new lines.
+//pointSet is taken by value so that it can be freed as soon as it has been split.
+inline void findHull(Executor& exec, PointList pointSet, Point segmentA, Point segmentB, Point furthest, std::vector<Point>& hullOut) {
+	if (pointSet.empty()) {
+		return;
+	}
+	hullOut.push_back(furthest);
+
+	PointList setOne, setTwo;
+	Point furthestOne, furthestTwo;
+	partitionAroundPoint(exec, segmentA, segmentB, furthest, pointSet, setOne, setTwo, furthestOne, furthestTwo);
+	bool spawn = pointSet.size() >= engineSerialCutoff;
+	pointSet = PointList();
+
+	if (!spawn) {
+		findHull(exec, std::move(setOne), segmentA, furthest, furthestOne, hullOut);
+		findHull(exec, std::move(setTwo), furthest, segmentB, furthestTwo, hullOut);
+		return;
+	}
+
+	std::vector<Point> hullTwo;
+	exec.invoke(
+		[&]() { findHull(exec, std::move(setOne), segmentA, furthest, furthestOne, hullOut); },
+		[&]() { findHull(exec, std::move(setTwo), furthest, segmentB, furthestTwo, hullTwo); });
+	hullOut.insert(hullOut.end(), hullTwo.begin(), hullTwo.end());
+}
+
+//computes the hull of a point list sorted with pointLessThan. the hull points come back unordered.
+inline std::vector<Point> computeHullPoints(Executor& exec, const PointList& sortedPoints) {
+	std::vector<Point> hull;
+	if (sortedPoints.empty()) {
+		return hull;
+	}
+
+	//tiny inputs skip the recursion entirely
+	if (sortedPoints.size() <= (size_t)smallHullLimit) {
+		hull.resize(sortedPoints.size());
+		hull.resize(smallHullPoints(sortedPoints.data(), (int)sortedPoints.size(), hull.data()));
+		return hull;
+	}
+
+	Point minPoint = sortedPoints[0];
+	Point maxPoint = sortedPoints[sortedPoints.size() - 1];
+	hull.push_back(minPoint);
+	if (comparePoints(minPoint, maxPoint)) {
+		return hull;
+	}
+	hull.push_back(maxPoint);
+
+	//the first split is along the line between the leftmost and rightmost points, same as SDP_FirstIteration
+	PointList upperSet, lowerSet;
+	Point upperFurthest, lowerFurthest;
+	partitionAroundPoint(exec, minPoint, minPoint, maxPoint, sortedPoints, upperSet, lowerSet, upperFurthest, lowerFurthest);
+
+	std::vector<Point> lowerHull;
+	exec.invoke(
+		[&]() { findHull(exec, std::move(upperSet), minPoint, maxPoint, upperFurthest, hull); },
+		[&]() { findHull(exec, std::move(lowerSet), maxPoint, minPoint, lowerFurthest, lowerHull); });
+	hull.insert(hull.end(), lowerHull.begin(), lowerHull.end());
+	return hull;
+}
+
+//same as computeHullPoints, but straight from compressed points (see compressedpoints.h).
+//the first split decodes one block at a time into a small buffer and partitions it with the blocked kernel while it's still in cache, so the whole list is never decompressed,
+//and the only full pass over memory is the compressed bytes. everything after the first split works on the normal point lists.
+inline std::vector<Point> computeHullPoints(Executor& exec, const CompressedPointList& sortedPoints) {
+	std::vector<Point> hull;
+	if (sortedPoints.empty()) {
+		return hull;
+	}
+	if (sortedPoints.size() <= (size_t)smallHullLimit) {
+		PointList points = sortedPoints.decompress(exec);
+		hull.resize(points.size());
+		hull.resize(smallHullPoints(points.data(), (int)points.size(), hull.data()));
+		return hull;
+	}
+
+	Point minPoint = sortedPoints.front();
+	Point maxPoint = sortedPoints.back();
+	hull.push_back(minPoint);
+	if (comparePoints(minPoint, maxPoint)) {
+		return hull;
+	}
+	hull.push_back(maxPoint);
+
+	PointList upperSet, lowerSet;
+	Point upperFurthest, lowerFurthest;
+	{
+		TRACE_SCOPE("partition (compressed)");
+		//each chunk is a run of whole blocks
+		size_t blocks = sortedPoints.blockCount();
+		size_t chunks = exec.chunkCount(blocks, std::max<size_t>(1, engineGrainSize / sortedPoints.pointsPerBlock()));
+		std::vector<PointList> chunkOne(chunks), chunkTwo(chunks);
+		std::vector<FurthestTracker> chunkFurthestOne(chunks), chunkFurthestTwo(chunks);
+
+		exec.parallelFor(chunks, [&](size_t firstChunk, size_t lastChunk) {
+			PointList decoded(sortedPoints.pointsPerBlock());
+			for (size_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+				size_t begin, end;
+				chunkBounds(blocks, chunks, chunk, begin, end);
+
+				//outputs are sized for the worst case and trimmed afterwards, same as the blocked path in partitionAroundPoint
+				size_t chunkPoints = 0;
+				for (size_t block = begin; block < end; block++) {
+					chunkPoints += sortedPoints.block(block).count;
+				}
+				chunkOne[chunk].resize(chunkPoints);
+				chunkTwo[chunk].resize(chunkPoints);
+
+				size_t sizeOne = 0, sizeTwo = 0;
+				for (size_t block = begin; block < end; block++) {
+					PERF_SCOPE("partition (compressed)", sortedPoints.block(block).count);
+					size_t count = sortedPoints.decodeBlock(block, decoded.data());
+
+					size_t countOne, countTwo;
+					FurthestTracker blockFurthestOne, blockFurthestTwo;
+					partitionBlocked(minPoint, minPoint, maxPoint, decoded.data(), count, chunkOne[chunk].data() + sizeOne, chunkTwo[chunk].data() + sizeTwo,
+						countOne, countTwo, blockFurthestOne, blockFurthestTwo);
+
+					//blocks are in list order, so a strict comparison keeps the earliest of any ties
+					if (blockFurthestOne.distance > chunkFurthestOne[chunk].distance) {
+						chunkFurthestOne[chunk].distance = blockFurthestOne.distance;
+						chunkFurthestOne[chunk].index = sizeOne + blockFurthestOne.index;
+					}
+					if (blockFurthestTwo.distance > chunkFurthestTwo[chunk].distance) {
+						chunkFurthestTwo[chunk].distance = blockFurthestTwo.distance;
+						chunkFurthestTwo[chunk].index = sizeTwo + blockFurthestTwo.index;
+					}
+					sizeOne += countOne;
+					sizeTwo += countTwo;
+				}
+				chunkOne[chunk].resize(sizeOne);
+				chunkTwo[chunk].resize(sizeTwo);
+			}
+			});
+
+		mergePartitionChunks(chunkOne, chunkTwo, chunkFurthestOne, chunkFurthestTwo, upperSet, lowerSet, upperFurthest, lowerFurthest);
+	}
+
+	std::vector<Point> lowerHull;
+	exec.invoke(
+		[&]() { findHull(exec, std::move(upperSet), minPoint, maxPoint, upperFurthest, hull); },
+		[&]() { findHull(exec, std::move(lowerSet), maxPoint, minPoint, lowerFurthest, lowerHull); });
+	hull.insert(hull.end(), lowerHull.begin(), lowerHull.end());
+	return hull;
+}
+
+//puts hull points (as returned by computeHullPoints) in order around the hull, starting from the leftmost point.
+//with y pointing up that's counterclockwise; on screen, where y points down, it's clockwise.
+//the points are split by the line from the leftmost to the rightmost point and each side is sorted along it, so unlike sorting by angle it's exact for any coordinates.
+inline std::vector<Point> orderHull(std::vector<Point> hull) {
+	if (hull.size() < 3) {
+		std::sort(hull.begin(), hull.end(), pointLessThan);
+		return hull;
+	}
+	std::sort(hull.begin(), hull.end(), pointLessThan);
+	SegmentClassifier line(hull.front(), hull.back());
+
+	//lower side left to right, then the upper side back from right to left
+	std::vector<Point> ordered;
+	ordered.reserve(hull.size());
+	ordered.push_back(hull.front());
+	for (size_t x = 1; x + 1 < hull.size(); x++) {
+		if (line.side(hull[x]) < 0) {
+			ordered.push_back(hull[x]);
+		}
+	}
+	ordered.push_back(hull.back());
+	for (size_t x = hull.size() - 1; x-- > 1;) {
+		if (line.side(hull[x]) >= 0) {
+			ordered.push_back(hull[x]);
+		}
+	}
+	return ordered;
+}
+
+//computes the hulls of many unrelated point sets at once, which don't need to be sorted. the hull points come back unordered.
+//the sets themselves are spread over the executor, and any set of 32 points or fewer goes straight to a small kernel without being sorted or copied.
+inline std::vector<std::vector<Point>> computeHullBatch(Executor& exec, const std::vector<std::vector<Point>>& pointSets) {
+	std::vector<std::vector<Point>> hulls(pointSets.size());
+	SequentialExecutor inner;
+
+	exec.parallelFor(pointSets.size(), [&](size_t begin, size_t end) {
+		for (size_t x = begin; x < end; x++) {
+			const std::vector<Point>& points = pointSets[x];
+			if (points.size() <= (size_t)smallHullLimit) {
+				Point hull[smallHullLimit];
+				int hullSize = smallHullPoints(points.data(), (int)points.size(), hull);
+				hulls[x].assign(hull, hull + hullSize);
+				continue;
+			}
+			PointList sorted(points.begin(), points.end());
+			std::sort(sorted.begin(), sorted.end(), pointLessThan);
+			hulls[x] = computeHullPoints(inner, sorted);
+		}
+		});
+	return hulls;
+}
+
+//times every available backend on a sample of the input and returns the quickest one.
+//the sample is every n-th point, which stays sorted and covers the same area as the full input.
+inline std::unique_ptr<Executor> selectFastestExecutor(const PointList& sortedPoints, size_t sampleSize = 1 << 20) {
+	PointList sample;
+	size_t stride = std::max<size_t>(1, sortedPoints.size() / sampleSize);
+	for (size_t x = 0; x < sortedPoints.size(); x += stride) {
+		sample.push_back(sortedPoints[x]);
+	}
+
+	std::unique_ptr<Executor> fastest;
+	double fastestTime = 0;
+	const ExecutorType candidates[] = { EX_Sequential, EX_StdParallel, EX_OpenMP, EX_ThreadPool };
+	for (ExecutorType type : candidates) {
+		if (!isExecutorAvailable(type)) {
+			continue;
+		}
+		std::unique_ptr<Executor> candidate = createExecutor(type);
+
+		//best of a few runs, so that thread start-up and cold caches don't decide the result
+		double bestTime = 0;
+		for (int run = 0; run < 3; run++) {
+			auto start = std::chrono::steady_clock::now();
+			computeHullPoints(*candidate, sample);
+			double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (run == 0 || time < bestTime) {
+				bestTime = time;
+			}
+		}
+
+		if (!fastest || bestTime < fastestTime) {
+			fastest = std::move(candidate);
+			fastestTime = bestTime;
+		}
+	}
+	return fastest;
+}
+
+inline std::unique_ptr<Executor> createExecutorForInput(ExecutorType type, const PointList& sortedPoints) {
+	if (type == EX_Fastest) {
+		return selectFastestExecutor(sortedPoints);
+	}
+	return createExecutor(type);
+}
@@ -0,0 +1,582 @@
+#pragma once
+
+/*
+A local hull service, for programs that need lots of small hulls and don't want to start a process for each one.
+
+"--serve [socket path]" listens on a Unix domain socket. Every connection can send any number of requests, one after another, each answered before the next is read.
+All numbers are in native byte order, since both ends are on the same machine:
+	request:  uint32 magic ('QHRQ'), uint32 type (HullRequestType), uint32 point count, then that many pairs of int32 x and y (none for a stats request)
+	response: uint32 magic ('QHRS'), uint32 status (HullResponseStatus), uint32 payload size in bytes, then the payload:
+		for a hull request, the hull as int32 x and y pairs, in order around it (see orderHull). a request with a point past +-2^30 gets HRS_OutOfRange and no payload.
+		for a stats request, a HullServiceStats
+Each connection gets its own thread, which only reads and writes. Hull requests from every connection go to one batching thread,
+which waits a moment for others to arrive and then hands the whole batch to computeHullBatch, so many small hulls share one trip through the executor.
+
+"--loadgen [socket path] [clients] [requests per client] [points per request]" connects to a running service and sends it random requests as fast as it can,
+then prints the latencies it saw along with the service's own stats.
+
+Only available where there are Unix domain sockets (Linux, macOS and other POSIX systems).
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <condition_variable>
+
+#include "point.h"
+#include "segmentclassifier.h"
+#include "executor.h"
+#include "hullengine.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HULL_SERVICE_AVAILABLE 1
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#define HULL_SERVICE_AVAILABLE 0
+#endif
+
+const char* const hullServiceDefaultSocket = "/tmp/quickhull.sock";
+
+const uint32_t hullRequestMagic = 0x51524851; //'QHRQ'
+const uint32_t hullResponseMagic = 0x53524851; //'QHRS'
+
+//biggest point set a single request may send (64 MB of points)
+const uint32_t hullServiceMaxPoints = 1 << 23;
+
+//most requests handed to the engine at once
+const size_t hullServiceMaxBatch = 256;
+
+//how long the batching thread waits for more requests after the first one arrives
+const std::chrono::microseconds hullServiceBatchWindow(200);
+
+//latencies kept for the percentiles. older ones are overwritten.
+const size_t hullServiceLatencySamples = 1 << 16;
+
+enum HullRequestType {
+	HRT_Hull = 1,
+	HRT_Stats = 2
+};
+
+enum HullResponseStatus {
+	HRS_Ok = 0,
+	HRS_BadRequest = 1,
+
+	//a point had a coordinate past +-2^30, which the engine can't work with exactly (see pointInRange() in segmentclassifier.h). the connection stays open.
+	HRS_OutOfRange = 2
+};
+
+struct HullMessageHeader {
+	uint32_t magic;
+	uint32_t type;
+	uint32_t count;
+};
+
+struct HullServiceStats {
+	uint64_t requests;
+	uint64_t batches;
+	double meanBatchSize;
+	double requestsPerSecond;
+	double p50Micros;
+	double p99Micros;
+};
+
+//latency percentiles over a set of samples, in microseconds
+inline void latencyPercentiles(std::vector<double> samples, double& p50, double& p99) {
+	p50 = p99 = 0;
+	if (samples.empty()) {
+		return;
+	}
+	size_t middle = samples.size() / 2;
+	std::nth_element(samples.begin(), samples.begin() + middle, samples.end());
+	p50 = samples[middle];
+	size_t high = std::min(samples.size() - 1, samples.size() * 99 / 100);
+	std::nth_element(samples.begin(), samples.begin() + high, samples.end());
+	p99 = samples[high];
+}
+
+#if HULL_SERVICE_AVAILABLE == 1
+
+//reads or writes exactly size bytes, returning false if the connection closes or fails first
+inline bool socketReadFully(int socket, void* data, size_t size) {
+	char* bytes = (char*)data;
+	while (size > 0) {
+		ssize_t done = recv(socket, bytes, size, 0);
+		if (done < 0 && errno == EINTR) {
+			continue;
+		}
+		if (done <= 0) {
+			return false;
+		}
+		bytes += done;
+		size -= done;
+	}
+	return true;
+}
+
+inline bool socketWriteFully(int socket, const void* data, size_t size) {
+	const char* bytes = (const char*)data;
+	while (size > 0) {
+		ssize_t done = send(socket, bytes, size, 0);
+		if (done < 0 && errno == EINTR) {
+			continue;
+		}
+		if (done <= 0) {
+			return false;
+		}
+		bytes += done;
+		size -= done;
+	}
+	return true;
+}
+
+inline bool socketAddress(const std::string& path, sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		return false;
+	}
+	memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	return true;
+}
+
+//clears the way for binding to the path. a socket file nobody answers on was left behind by a run that didn't shut down cleanly, so it's removed.
+//returns false if something is still listening there (or can't be ruled out), since removing its file would quietly take the address away from it.
+inline bool removeStaleSocket(const sockaddr_un& address) {
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (probe < 0) {
+		return false;
+	}
+	int result = connect(probe, (const sockaddr*)&address, sizeof(address));
+	int error = errno;
+	close(probe);
+	if (result == 0) {
+		return false;
+	}
+	if (error == ECONNREFUSED) {
+		unlink(address.sun_path);
+		return true;
+	}
+	return error == ENOENT;
+}
+
+inline bool sendHullResponse(int socket, HullResponseStatus status, const void* payload, size_t bytes) {
+	HullMessageHeader header = { hullResponseMagic, (uint32_t)status, (uint32_t)bytes };
+	return socketWriteFully(socket, &header, sizeof(header)) && (bytes == 0 || socketWriteFully(socket, payload, bytes));
+}
+
+class HullService {
+private:
+	struct PendingRequest {
+		std::vector<Point> points;
+		std::promise<std::vector<Point>> hull;
+	};
+
+	Executor& exec;
+	std::string socketPath;
+	int listener = -1;
+	bool inUse = false;
+	std::atomic<bool>& stopRequested;
+
+	std::mutex pendingLock;
+	std::condition_variable pendingReady;
+	std::deque<PendingRequest*> pending;
+	bool stopping = false;
+
+	//each connection has at most one request waiting, so once this many are pending there's nothing left to wait for
+	std::atomic<size_t> activeConnections{ 0 };
+
+	std::mutex statsLock;
+	std::vector<double> latencies;
+	size_t nextLatency = 0;
+	uint64_t requestCount = 0;
+	uint64_t batchCount = 0;
+	uint64_t batchedRequests = 0;
+	std::chrono::steady_clock::time_point startTime;
+
+	struct Connection {
+		int socket;
+		std::thread thread;
+		std::shared_ptr<std::atomic<bool>> finished;
+	};
+
+	std::mutex connectionsLock;
+	std::vector<Connection> connections;
+
+	void recordLatency(double micros) {
+		std::lock_guard<std::mutex> lock(statsLock);
+		requestCount++;
+		if (latencies.size() < hullServiceLatencySamples) {
+			latencies.push_back(micros);
+		}
+		else {
+			latencies[nextLatency] = micros;
+			nextLatency = (nextLatency + 1) % hullServiceLatencySamples;
+		}
+	}
+
+	//takes waiting requests in batches and runs them through the engine together
+	void batchLoop() {
+		while (true) {
+			std::vector<PendingRequest*> batch;
+			{
+				std::unique_lock<std::mutex> lock(pendingLock);
+				pendingReady.wait(lock, [&]() { return stopping || !pending.empty(); });
+				if (pending.empty()) {
+					return;
+				}
+
+				//give other connections a moment to add to the batch, unless it's already full or every connection is already in it
+				auto deadline = std::chrono::steady_clock::now() + hullServiceBatchWindow;
+				pendingReady.wait_until(lock, deadline, [&]() {
+					return stopping || pending.size() >= hullServiceMaxBatch || pending.size() >= activeConnections;
+					});
+
+				while (!pending.empty() && batch.size() < hullServiceMaxBatch) {
+					batch.push_back(pending.front());
+					pending.pop_front();
+				}
+			}
+
+			std::vector<std::vector<Point>> pointSets(batch.size());
+			for (size_t x = 0; x < batch.size(); x++) {
+				pointSets[x] = std::move(batch[x]->points);
+			}
+			std::vector<std::vector<Point>> hulls = computeHullBatch(exec, pointSets);
+			for (size_t x = 0; x < batch.size(); x++) {
+				batch[x]->hull.set_value(orderHull(std::move(hulls[x])));
+			}
+
+			std::lock_guard<std::mutex> lock(statsLock);
+			batchCount++;
+			batchedRequests += batch.size();
+		}
+	}
+
+	//answers one client's requests until it disconnects
+	void connectionLoop(int socket, std::atomic<bool>& finished) {
+		activeConnections++;
+		HullMessageHeader header;
+		while (socketReadFully(socket, &header, sizeof(header))) {
+			if (header.magic != hullRequestMagic || (header.type != HRT_Hull && header.type != HRT_Stats) || header.count > hullServiceMaxPoints) {
+				sendHullResponse(socket, HRS_BadRequest, nullptr, 0);
+				break;
+			}
+
+			if (header.type == HRT_Stats) {
+				HullServiceStats stats = currentStats();
+				if (!sendHullResponse(socket, HRS_Ok, &stats, sizeof(stats))) {
+					break;
+				}
+				continue;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			PendingRequest request;
+			request.points.resize(header.count);
+			if (!socketReadFully(socket, request.points.data(), header.count * sizeof(Point))) {
+				break;
+			}
+			if (!std::all_of(request.points.begin(), request.points.end(), pointInRange)) {
+				if (!sendHullResponse(socket, HRS_OutOfRange, nullptr, 0)) {
+					break;
+				}
+				continue;
+			}
+			std::future<std::vector<Point>> result = request.hull.get_future();
+			{
+				std::lock_guard<std::mutex> lock(pendingLock);
+				pending.push_back(&request);
+			}
+			pendingReady.notify_one();
+
+			std::vector<Point> hull = result.get();
+			bool sent = sendHullResponse(socket, HRS_Ok, hull.data(), hull.size() * sizeof(Point));
+			recordLatency(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+			if (!sent) {
+				break;
+			}
+		}
+		//the socket is closed by whoever joins this thread, so that its number can't be reused while it's still listed
+		activeConnections--;
+		pendingReady.notify_one();
+		finished = true;
+	}
+
+	//joins the threads of connections that have ended. called from the accepting thread.
+	void reapConnections() {
+		std::lock_guard<std::mutex> lock(connectionsLock);
+		for (size_t x = 0; x < connections.size();) {
+			if (!*connections[x].finished) {
+				x++;
+				continue;
+			}
+			connections[x].thread.join();
+			close(connections[x].socket);
+			connections[x] = std::move(connections.back());
+			connections.pop_back();
+		}
+	}
+
+public:
+	HullService(Executor& executor, const std::string& path, std::atomic<bool>& stopFlag) : exec(executor), socketPath(path), stopRequested(stopFlag) {}
+
+	HullServiceStats currentStats() {
+		std::lock_guard<std::mutex> lock(statsLock);
+		HullServiceStats stats;
+		stats.requests = requestCount;
+		stats.batches = batchCount;
+		stats.meanBatchSize = batchCount > 0 ? (double)batchedRequests / batchCount : 0;
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		stats.requestsPerSecond = seconds > 0 ? requestCount / seconds : 0;
+		latencyPercentiles(latencies, stats.p50Micros, stats.p99Micros);
+		return stats;
+	}
+
+	//whether run() failed because another service is already listening on the path
+	bool addressInUse() const {
+		return inUse;
+	}
+
+	//listens until stopFlag is set. returns false if the socket couldn't be set up.
+	bool run() {
+		sockaddr_un address;
+		if (!socketAddress(socketPath, address)) {
+			return false;
+		}
+		listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener < 0) {
+			return false;
+		}
+
+		//a socket file left behind by a previous run would make bind fail, but one a running service is using has to be left alone
+		if (!removeStaleSocket(address)) {
+			inUse = true;
+			close(listener);
+			return false;
+		}
+		if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+			close(listener);
+			return false;
+		}
+
+		startTime = std::chrono::steady_clock::now();
+		std::thread batcher([&]() { batchLoop(); });
+
+		while (!stopRequested) {
+			//wake up now and then to check whether it's time to stop
+			pollfd waiting = { listener, POLLIN, 0 };
+			if (poll(&waiting, 1, 200) <= 0) {
+				continue;
+			}
+			reapConnections();
+			int client = accept(listener, nullptr, nullptr);
+			if (client < 0) {
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(connectionsLock);
+			Connection connection;
+			connection.socket = client;
+			connection.finished = std::make_shared<std::atomic<bool>>(false);
+			std::atomic<bool>* finished = connection.finished.get();
+			connection.thread = std::thread([this, client, finished]() { connectionLoop(client, *finished); });
+			connections.push_back(std::move(connection));
+		}
+
+		//wake up connections blocked on reads, let them finish, then stop the batcher
+		close(listener);
+		unlink(socketPath.c_str());
+		{
+			std::lock_guard<std::mutex> lock(connectionsLock);
+			for (Connection& connection : connections) {
+				shutdown(connection.socket, SHUT_RDWR);
+			}
+			for (Connection& connection : connections) {
+				connection.thread.join();
+				close(connection.socket);
+			}
+			connections.clear();
+		}
+		{
+			std::lock_guard<std::mutex> lock(pendingLock);
+			stopping = true;
+		}
+		pendingReady.notify_all();
+		batcher.join();
+		return true;
+	}
+};
+
+//a connection to a running service
+class HullClient {
+private:
+	int server = -1;
+
+	bool readResponse(std::vector<char>& payload) {
+		HullMessageHeader header;
+		if (!socketReadFully(server, &header, sizeof(header)) || header.magic != hullResponseMagic || header.type != HRS_Ok) {
+			return false;
+		}
+		payload.resize(header.count);
+		return header.count == 0 || socketReadFully(server, payload.data(), header.count);
+	}
+
+public:
+	HullClient() {}
+	HullClient(const HullClient&) = delete;
+	HullClient& operator=(const HullClient&) = delete;
+
+	~HullClient() {
+		if (server >= 0) {
+			close(server);
+		}
+	}
+
+	bool connectTo(const std::string& path) {
+		sockaddr_un address;
+		if (!socketAddress(path, address)) {
+			return false;
+		}
+		server = socket(AF_UNIX, SOCK_STREAM, 0);
+		return server >= 0 && connect(server, (sockaddr*)&address, sizeof(address)) == 0;
+	}
+
+	//sends a point set and waits for its ordered hull
+	bool requestHull(const std::vector<Point>& points, std::vector<Point>& hull) {
+		HullMessageHeader header = { hullRequestMagic, HRT_Hull, (uint32_t)points.size() };
+		std::vector<char> payload;
+		if (!socketWriteFully(server, &header, sizeof(header)) || !socketWriteFully(server, points.data(), points.size() * sizeof(Point)) || !readResponse(payload)) {
+			return false;
+		}
+		hull.resize(payload.size() / sizeof(Point));
+		memcpy(hull.data(), payload.data(), hull.size() * sizeof(Point));
+		return true;
+	}
+
+	bool requestStats(HullServiceStats& stats) {
+		HullMessageHeader header = { hullRequestMagic, HRT_Stats, 0 };
+		std::vector<char> payload;
+		if (!socketWriteFully(server, &header, sizeof(header)) || !readResponse(payload) || payload.size() != sizeof(stats)) {
+			return false;
+		}
+		memcpy(&stats, payload.data(), sizeof(stats));
+		return true;
+	}
+};
+
+inline std::atomic<bool>& hullServiceStopFlag() {
+	static std::atomic<bool> stop{ false };
+	return stop;
+}
+
+extern "C" inline void hullServiceSignalHandler(int) {
+	hullServiceStopFlag() = true;
+}
+
+//runs the service until SIGINT or SIGTERM
+inline int runHullService(Executor& exec, const std::string& path) {
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, hullServiceSignalHandler);
+	signal(SIGTERM, hullServiceSignalHandler);
+
+	HullService service(exec, path, hullServiceStopFlag());
+	printf("Serving hulls on %s with the %s executor (Ctrl+C to stop)\n", path.c_str(), exec.name());
+	fflush(stdout);
+	if (!service.run()) {
+		if (service.addressInUse()) {
+			printf("Error: %s is already in use by another running service\n", path.c_str());
+			return 1;
+		}
+		printf("Error: Unable to listen on %s\n", path.c_str());
+		return 1;
+	}
+
+	HullServiceStats stats = service.currentStats();
+	printf("Served %llu requests in %llu batches, p50 %.1f us, p99 %.1f us\n", (unsigned long long)stats.requests, (unsigned long long)stats.batches, stats.p50Micros, stats.p99Micros);
+	return 0;
+}
+
+//sends requests from several clients at once and reports what it saw
+inline int runHullLoadGenerator(const std::string& path, int clients, int requestsPerClient, int pointsPerRequest) {
+	signal(SIGPIPE, SIG_IGN);
+
+	std::vector<std::vector<double>> clientLatencies(clients);
+	std::atomic<int> failures{ 0 };
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int client = 0; client < clients; client++) {
+		threads.push_back(std::thread([&, client]() {
+			HullClient connection;
+			if (!connection.connectTo(path)) {
+				failures++;
+				return;
+			}
+			unsigned int state = 12345 + client;
+			std::vector<Point> points(pointsPerRequest), hull;
+			for (int request = 0; request < requestsPerClient; request++) {
+				for (Point& p : points) {
+					state = state * 1664525u + 1013904223u;
+					p.x = (state >> 8) % 10000;
+					state = state * 1664525u + 1013904223u;
+					p.y = (state >> 8) % 10000;
+				}
+				auto sent = std::chrono::steady_clock::now();
+				if (!connection.requestHull(points, hull)) {
+					failures++;
+					return;
+				}
+				clientLatencies[client].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+			}
+			}));
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<double> latencies;
+	for (const std::vector<double>& samples : clientLatencies) {
+		latencies.insert(latencies.end(), samples.begin(), samples.end());
+	}
+	double p50, p99;
+	latencyPercentiles(latencies, p50, p99);
+	printf("Load generator: %zu requests of %d points from %d clients in %.2f s (%d failed)\n", latencies.size(), pointsPerRequest, clients, seconds, failures.load());
+	printf("  client side: %.0f requests/s, p50 %.1f us, p99 %.1f us\n", latencies.size() / seconds, p50, p99);
+
+	HullClient statsConnection;
+	HullServiceStats stats;
+	if (statsConnection.connectTo(path) && statsConnection.requestStats(stats)) {
+		printf("  service: %llu requests in %llu batches (%.1f per batch), %.0f requests/s since start, p50 %.1f us, p99 %.1f us\n",
+			(unsigned long long)stats.requests, (unsigned long long)stats.batches, stats.meanBatchSize, stats.requestsPerSecond, stats.p50Micros, stats.p99Micros);
+	}
+	return failures > 0 ? 1 : 0;
+}
+
+#else
+
+inline int runHullService(Executor&, const std::string&) {
+	printf("Error: The hull service needs Unix domain sockets, which aren't available on this platform\n");
+	return 1;
+}
+
+inline int runHullLoadGenerator(const std::string&, int, int, int) {
+	printf("Error: The hull service needs Unix domain sockets, which aren't available on this platform\n");
+	return 1;
+}
+
+#endif
@@ -0,0 +1,301 @@
+#pragma once
+
+/*
+Allocation and peak memory profiling.
+
+When turned on, this replaces the global operator new and delete so that every allocation is counted.
+The run is split into phases with MEMORY_PHASE("name"), and each phase gets its own count of allocations and bytes, plus the resident memory (RSS) measured when it ends.
+Big point buffers that bigbuffer.h maps straight from the OS are counted too, since they never go through operator new.
+It also keeps track of how many StepData nodes are alive at once, since those are what the stepped visualizer's memory use mostly comes down to.
+
+MEMORY_REPORT(path) prints the summary and saves it to a file. The peak numbers are what container memory limits should be set from.
+
+Turned on with ENABLE_MEMORY_PROFILING in quickhull.cpp. When it's off, the macros expand to nothing and the normal operator new is used.
+Because it replaces operator new, this file can only be included from one source file (quickhull.cpp).
+*/
+
+#ifndef ENABLE_MEMORY_PROFILING
+#define ENABLE_MEMORY_PROFILING 0
+#endif
+
+#if ENABLE_MEMORY_PROFILING == 1
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+const int maxMemoryPhases = 64;
+
+struct MemoryPhaseTotals {
+	const char* name = nullptr;
+	std::atomic<uint64_t> allocations{ 0 };
+	std::atomic<uint64_t> bytes{ 0 };
+	std::atomic<uint64_t> peakLiveBytes{ 0 };
+	std::atomic<uint64_t> rssAtEnd{ 0 };
+};
+
+//all of the counters. nothing in here allocates, since it's called from inside operator new.
+struct MemoryProfile {
+	MemoryPhaseTotals phases[maxMemoryPhases];
+	std::atomic<int> phaseCount{ 1 };
+	std::atomic<int> currentPhase{ 0 };
+	std::mutex phaseLock;
+
+	std::atomic<uint64_t> totalAllocations{ 0 };
+	std::atomic<uint64_t> totalBytes{ 0 };
+	std::atomic<int64_t> liveBytes{ 0 };
+	std::atomic<int64_t> peakLiveBytes{ 0 };
+
+	std::atomic<int64_t> liveStepData{ 0 };
+	std::atomic<int64_t> peakStepData{ 0 };
+
+	MemoryProfile() {
+		phases[0].name = "(outside any phase)";
+	}
+
+	static void raisePeak(std::atomic<int64_t>& peak, int64_t value) {
+		int64_t previous = peak.load(std::memory_order_relaxed);
+		while (value > previous && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+		}
+	}
+
+	void countAllocation(size_t size) {
+		MemoryPhaseTotals& phase = phases[currentPhase.load(std::memory_order_relaxed)];
+		phase.allocations.fetch_add(1, std::memory_order_relaxed);
+		phase.bytes.fetch_add(size, std::memory_order_relaxed);
+		totalAllocations.fetch_add(1, std::memory_order_relaxed);
+		totalBytes.fetch_add(size, std::memory_order_relaxed);
+
+		int64_t live = liveBytes.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+		raisePeak(peakLiveBytes, live);
+		uint64_t phasePeak = phase.peakLiveBytes.load(std::memory_order_relaxed);
+		while ((uint64_t)live > phasePeak && !phase.peakLiveBytes.compare_exchange_weak(phasePeak, (uint64_t)live, std::memory_order_relaxed)) {
+		}
+	}
+
+	void countRelease(size_t size) {
+		liveBytes.fetch_sub((int64_t)size, std::memory_order_relaxed);
+	}
+
+	void stepDataCreated() {
+		raisePeak(peakStepData, liveStepData.fetch_add(1, std::memory_order_relaxed) + 1);
+	}
+
+	void stepDataDestroyed() {
+		liveStepData.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	//finds or adds a phase by name and returns its index
+	int phaseIndex(const char* name) {
+		std::lock_guard<std::mutex> lock(phaseLock);
+		int count = phaseCount.load();
+		for (int x = 0; x < count; x++) {
+			if (strcmp(phases[x].name, name) == 0) {
+				return x;
+			}
+		}
+		if (count == maxMemoryPhases) {
+			return 0;
+		}
+		phases[count].name = name;
+		phaseCount.store(count + 1);
+		return count;
+	}
+};
+
+inline MemoryProfile& memoryProfile() {
+	static MemoryProfile profile;
+	return profile;
+}
+
+//resident memory right now, and the most it has been at any point, in bytes
+inline uint64_t currentRSS() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#else
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm == nullptr) {
+		return 0;
+	}
+	unsigned long long totalPages = 0, residentPages = 0;
+	int read = fscanf(statm, "%llu %llu", &totalPages, &residentPages);
+	fclose(statm);
+	return read == 2 ? residentPages * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+inline uint64_t peakRSS() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return (uint64_t)usage.ru_maxrss;
+#else
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+//attributes every allocation made until the end of the enclosing block to a phase, then samples RSS
+class MemoryPhase {
+private:
+	int index;
+	int previous;
+
+public:
+	MemoryPhase(const char* name) {
+		MemoryProfile& profile = memoryProfile();
+		index = profile.phaseIndex(name);
+		previous = profile.currentPhase.exchange(index);
+	}
+
+	~MemoryPhase() {
+		MemoryProfile& profile = memoryProfile();
+		uint64_t rss = currentRSS();
+		if (rss > profile.phases[index].rssAtEnd.load()) {
+			profile.phases[index].rssAtEnd.store(rss);
+		}
+		profile.currentPhase.store(previous);
+	}
+};
+
+inline void writeMemoryReport(const char* path) {
+	MemoryProfile& profile = memoryProfile();
+	FILE* file = fopen(path, "w");
+	FILE* outputs[2] = { stdout, file };
+
+	for (FILE* out : outputs) {
+		if (out == nullptr) {
+			continue;
+		}
+		fprintf(out, "Memory profile\n");
+		fprintf(out, "%-32s %12s %14s %16s %14s\n", "phase", "allocations", "MB allocated", "peak live MB", "max RSS MB");
+		for (int x = 0; x < profile.phaseCount.load(); x++) {
+			const MemoryPhaseTotals& phase = profile.phases[x];
+			fprintf(out, "%-32s %12llu %14.2f %16.2f %14.2f\n", phase.name, (unsigned long long)phase.allocations.load(),
+				phase.bytes.load() / 1048576.0, phase.peakLiveBytes.load() / 1048576.0, phase.rssAtEnd.load() / 1048576.0);
+		}
+		fprintf(out, "\ntotal allocations: %llu (%.2f MB)\n", (unsigned long long)profile.totalAllocations.load(), profile.totalBytes.load() / 1048576.0);
+		fprintf(out, "peak live heap: %.2f MB\n", profile.peakLiveBytes.load() / 1048576.0);
+		fprintf(out, "peak RSS: %.2f MB\n", peakRSS() / 1048576.0);
+		fprintf(out, "peak live StepData nodes: %lld\n", (long long)profile.peakStepData.load());
+	}
+
+	if (file != nullptr) {
+		fclose(file);
+	}
+	else {
+		printf("Error: Unable to create memory profile file %s!\n", path);
+	}
+}
+
+//every allocation gets a small header in front of it, holding the size and where the underlying block starts.
+//that's what lets the unsized operator delete know how much is being freed.
+struct AllocationHeader {
+	void* block;
+	size_t size;
+};
+
+const size_t allocationHeaderSpace = (sizeof(AllocationHeader) + 15) / 16 * 16;
+
+inline void* profiledAllocate(size_t size, size_t alignment) {
+	if (alignment < 16) {
+		alignment = 16;
+	}
+	char* block = (char*)malloc(size + allocationHeaderSpace + alignment);
+	if (block == nullptr) {
+		return nullptr;
+	}
+	char* memory = (char*)(((uintptr_t)block + allocationHeaderSpace + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	AllocationHeader* header = (AllocationHeader*)(memory - sizeof(AllocationHeader));
+	header->block = block;
+	header->size = size;
+	memoryProfile().countAllocation(size);
+	return memory;
+}
+
+inline void profiledRelease(void* memory) {
+	if (memory == nullptr) {
+		return;
+	}
+	AllocationHeader* header = (AllocationHeader*)((char*)memory - sizeof(AllocationHeader));
+	memoryProfile().countRelease(header->size);
+	free(header->block);
+}
+
+inline void* profiledAllocateOrThrow(size_t size, size_t alignment) {
+	void* memory = profiledAllocate(size, alignment);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+//replacement operators. these must not be inline, and must only be compiled once.
+void* operator new(size_t size) { return profiledAllocateOrThrow(size, 16); }
+void* operator new[](size_t size) { return profiledAllocateOrThrow(size, 16); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return profiledAllocate(size, 16); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return profiledAllocate(size, 16); }
+void* operator new(size_t size, std::align_val_t alignment) { return profiledAllocateOrThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return profiledAllocateOrThrow(size, (size_t)alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return profiledAllocate(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return profiledAllocate(size, (size_t)alignment); }
+
+void operator delete(void* memory) noexcept { profiledRelease(memory); }
+void operator delete[](void* memory) noexcept { profiledRelease(memory); }
+void operator delete(void* memory, size_t) noexcept { profiledRelease(memory); }
+void operator delete[](void* memory, size_t) noexcept { profiledRelease(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { profiledRelease(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { profiledRelease(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { profiledRelease(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { profiledRelease(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { profiledRelease(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { profiledRelease(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { profiledRelease(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { profiledRelease(memory); }
+
+#define MEMORY_CONCAT_INNER(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_INNER(a, b)
+#define MEMORY_PHASE(name) MemoryPhase MEMORY_CONCAT(memoryPhase, __LINE__)(name)
+#define MEMORY_COUNT_MAPPED(bytes) memoryProfile().countAllocation(bytes)
+#define MEMORY_UNCOUNT_MAPPED(bytes) memoryProfile().countRelease(bytes)
+#define MEMORY_STEPDATA_CREATED() memoryProfile().stepDataCreated()
+#define MEMORY_STEPDATA_DESTROYED() memoryProfile().stepDataDestroyed()
+#define MEMORY_REPORT(path) writeMemoryReport(path)
+
+#else
+
+#define MEMORY_PHASE(name)
+#define MEMORY_COUNT_MAPPED(bytes)
+#define MEMORY_UNCOUNT_MAPPED(bytes)
+#define MEMORY_STEPDATA_CREATED()
+#define MEMORY_STEPDATA_DESTROYED()
+#define MEMORY_REPORT(path)
+
+#endif
@@ -0,0 +1,252 @@
+#pragma once
+
+/*
+Hardware performance counters around the engine's phases.
+
+Wall-clock time alone doesn't say why a loop is slow. This opens the CPU's own counters (cycles, instructions, branch misses and last-level cache misses)
+through Linux's perf_event_open, and PERF_SCOPE("name", points) adds up how many of each a block used.
+PERF_REPORT() prints a table per phase at the end of the run: time, IPC (instructions per cycle), and cycles, branch misses and cache misses per point.
+
+Counters are opened per thread and only count that thread, so scopes go inside the executor's chunks rather than around whole parallel loops,
+and the totals still add up across every thread that did some of the work.
+
+If the counters can't be opened (not Linux, no permission, or running in a VM or container without them) only the timing is reported.
+On Linux, "sysctl kernel.perf_event_paranoid=2" or lower is usually enough, since only user-space events are counted.
+
+Turned on with ENABLE_PERF_COUNTERS in quickhull.cpp. When it's off, PERF_SCOPE and PERF_REPORT expand to nothing.
+*/
+
+#ifndef ENABLE_PERF_COUNTERS
+#define ENABLE_PERF_COUNTERS 0
+#endif
+
+#if ENABLE_PERF_COUNTERS == 1
+
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+enum PerfCounterKind {
+	PC_Cycles,
+	PC_Instructions,
+	PC_BranchMisses,
+	PC_CacheMisses,
+	PC_Count
+};
+
+//one group of counters for the calling thread. the counters run all the time, and scopes read them at the start and end.
+class PerfCounterGroup {
+private:
+	int fds[PC_Count];
+
+	//where each counter's value sits in a group read, or -1 if it couldn't be opened
+	int readSlot[PC_Count];
+	int openCount = 0;
+
+public:
+	PerfCounterGroup() {
+		for (int x = 0; x < PC_Count; x++) {
+			fds[x] = -1;
+			readSlot[x] = -1;
+		}
+
+#ifdef __linux__
+		const uint32_t types[PC_Count] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+		const uint64_t configs[PC_Count] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_BRANCH_MISSES,
+			PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+		};
+
+		for (int x = 0; x < PC_Count; x++) {
+			perf_event_attr attributes;
+			memset(&attributes, 0, sizeof(attributes));
+			attributes.size = sizeof(attributes);
+			attributes.type = types[x];
+			attributes.config = configs[x];
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.read_format = PERF_FORMAT_GROUP;
+
+			//cycles lead the group. without them nothing else is worth opening.
+			int leader = x == 0 ? -1 : fds[0];
+			fds[x] = (int)syscall(__NR_perf_event_open, &attributes, 0, -1, leader, 0);
+			if (fds[x] < 0) {
+				if (x == 0) {
+					return;
+				}
+				continue;
+			}
+			readSlot[x] = openCount++;
+		}
+#endif
+	}
+
+	~PerfCounterGroup() {
+#ifdef __linux__
+		for (int x = PC_Count - 1; x >= 0; x--) {
+			if (fds[x] >= 0) {
+				close(fds[x]);
+			}
+		}
+#endif
+	}
+
+	bool available() const {
+		return openCount > 0;
+	}
+
+	bool hasCounter(PerfCounterKind kind) const {
+		return readSlot[kind] >= 0;
+	}
+
+	//reads every counter at once. counters that couldn't be opened read as zero.
+	void read(uint64_t values[PC_Count]) {
+		memset(values, 0, sizeof(uint64_t) * PC_Count);
+#ifdef __linux__
+		if (!available()) {
+			return;
+		}
+		uint64_t buffer[1 + PC_Count];
+		if (::read(fds[0], buffer, sizeof(buffer)) <= 0) {
+			return;
+		}
+		for (int x = 0; x < PC_Count; x++) {
+			if (readSlot[x] >= 0 && (uint64_t)readSlot[x] < buffer[0]) {
+				values[x] = buffer[1 + readSlot[x]];
+			}
+		}
+#endif
+	}
+};
+
+inline PerfCounterGroup& threadPerfCounters() {
+	thread_local PerfCounterGroup group;
+	return group;
+}
+
+struct PerfPhaseTotals {
+	const char* name;
+	uint64_t calls = 0;
+	uint64_t points = 0;
+	long long nanos = 0;
+	uint64_t counters[PC_Count] = {};
+	bool counted = false;
+};
+
+class PerfReport {
+private:
+	std::mutex totalsLock;
+	std::vector<PerfPhaseTotals> phases;
+
+public:
+	void add(const char* name, uint64_t points, long long nanos, const uint64_t counters[PC_Count], bool counted) {
+		std::lock_guard<std::mutex> lock(totalsLock);
+		PerfPhaseTotals* phase = nullptr;
+		for (PerfPhaseTotals& existing : phases) {
+			if (strcmp(existing.name, name) == 0) {
+				phase = &existing;
+				break;
+			}
+		}
+		if (phase == nullptr) {
+			phases.push_back(PerfPhaseTotals());
+			phase = &phases.back();
+			phase->name = name;
+		}
+
+		phase->calls++;
+		phase->points += points;
+		phase->nanos += nanos;
+		phase->counted = phase->counted || counted;
+		for (int x = 0; x < PC_Count; x++) {
+			phase->counters[x] += counters[x];
+		}
+	}
+
+	void print() {
+		std::lock_guard<std::mutex> lock(totalsLock);
+		PerfCounterGroup& group = threadPerfCounters();
+		if (!group.available()) {
+			printf("Hardware counters unavailable (no permission, or not supported here), so only timings are shown.\n");
+		}
+
+		printf("%-32s %8s %12s %10s %10s %6s %14s %14s\n", "phase", "calls", "points", "ms", "cycles/pt", "IPC", "br-miss/pt", "LLC-miss/pt");
+		for (const PerfPhaseTotals& phase : phases) {
+			double points = phase.points > 0 ? (double)phase.points : 1.0;
+			printf("%-32s %8llu %12llu %10.2f ", phase.name, (unsigned long long)phase.calls, (unsigned long long)phase.points, phase.nanos / 1e6);
+			if (!phase.counted) {
+				printf("%10s %6s %14s %14s\n", "-", "-", "-", "-");
+				continue;
+			}
+			double cycles = (double)phase.counters[PC_Cycles];
+			printf("%10.2f %6.2f ", cycles / points, cycles > 0 ? phase.counters[PC_Instructions] / cycles : 0.0);
+			if (group.hasCounter(PC_BranchMisses)) {
+				printf("%14.4f ", phase.counters[PC_BranchMisses] / points);
+			}
+			else {
+				printf("%14s ", "-");
+			}
+			if (group.hasCounter(PC_CacheMisses)) {
+				printf("%14.4f\n", phase.counters[PC_CacheMisses] / points);
+			}
+			else {
+				printf("%14s\n", "-");
+			}
+		}
+	}
+};
+
+inline PerfReport& perfReport() {
+	static PerfReport report;
+	return report;
+}
+
+//counts the time and hardware events between its creation and the end of the enclosing block, on the current thread
+class PerfScope {
+private:
+	const char* name;
+	uint64_t points;
+	std::chrono::steady_clock::time_point start;
+	uint64_t startCounters[PC_Count];
+
+public:
+	PerfScope(const char* phaseName, uint64_t pointCount) : name(phaseName), points(pointCount) {
+		threadPerfCounters().read(startCounters);
+		start = std::chrono::steady_clock::now();
+	}
+
+	~PerfScope() {
+		long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		PerfCounterGroup& group = threadPerfCounters();
+		uint64_t endCounters[PC_Count];
+		group.read(endCounters);
+		for (int x = 0; x < PC_Count; x++) {
+			endCounters[x] -= startCounters[x];
+		}
+		perfReport().add(name, points, nanos, endCounters, group.available());
+	}
+};
+
+#define PERF_CONCAT_INNER(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_INNER(a, b)
+#define PERF_SCOPE(name, points) PerfScope PERF_CONCAT(perfScope, __LINE__)(name, points)
+#define PERF_REPORT() perfReport().print()
+
+#else
+
+#define PERF_SCOPE(name, points)
+#define PERF_REPORT()
+
+#endif
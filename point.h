@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "bigbuffer.h"
+
+//simple point structure. x and y coordinate.
+struct Point {
+	int x;
+	int y;
+};
+
+//orders points left-to-right, top-to-bottom. every point list the hull works on is kept in this order.
+constexpr bool pointLessThan(const Point& left, const Point& right) {
+	return (left.x < right.x) || (left.x == right.x && left.y < right.y);
+}
+
+constexpr bool comparePoints(const Point lhs, const Point rhs) {
+	return lhs.x == rhs.x && lhs.y == rhs.y;
+}
+
+//the type used for every list of input points (as opposed to the much smaller lists of hull points). see bigbuffer.h for how they're allocated.
+typedef std::vector<Point, BigBufferAllocator<Point>> PointList;
@@ -0,0 +1,495 @@
+#pragma once
+
+/*
+A binary, column-oriented file format for point sets, loaded through a memory mapping.
+
+Layout (all little-endian, every section starts on a 64-byte boundary):
+	header          64 bytes, see PointFileHeader
+	x column        int32 per point
+	y column        int32 per point
+	ids             uint64 per point (optional)
+	chunk bounds    one PointChunkBounds per chunk of chunkPoints points (optional)
+
+Keeping x and y in separate columns means the file can be mapped and read in place: MappedPointFile hands out the columns as plain arrays, without any parsing or copying.
+The engine works on interleaved Points, so loadPointFile does one pass over the mapping to build a PointList, split across the executor.
+
+The chunk bounds are the bounding box of each run of chunkPoints points. When loading with a hull that's already known (from an earlier file, for example),
+any chunk whose box is strictly inside that hull can't contain a hull point, so it's skipped without its points ever being touched.
+loadPointFileHullCandidates gets such a hull from the file itself: it loads the chunks whose boxes reach furthest in eight directions first,
+and skips every chunk strictly inside their hull. That only helps when each chunk's points are close together:
+in a file sorted by x, about half of an evenly spread input is skipped, while a file in random order has boxes covering everything and loses nothing.
+
+Files can hold any int32, but the engine is only exact up to +-2^30 (see pointInRange() in segmentclassifier.h), so loading fails on a file with a point past that.
+A file with chunk bounds is turned down from its boxes alone, before any point is copied.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include "point.h"
+#include "executor.h"
+#include "segmentclassifier.h"
+#include "hullengine.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+const char pointFileMagic[8] = { 'Q', 'H', 'P', 'O', 'I', 'N', 'T', 'S' };
+const uint32_t pointFileVersion = 1;
+
+//alignment of every section in the file
+const uint64_t pointFileAlignment = 64;
+
+//default amount of points covered by one chunk bounding box
+const uint32_t pointFileChunkPoints = 65536;
+
+enum PointFileFlags {
+	PFF_HasIds = 1,
+	PFF_HasChunkBounds = 2
+};
+
+struct PointFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t pointCount;
+	uint32_t chunkPoints;
+	uint32_t chunkCount;
+
+	//byte offsets of each section from the start of the file, 0 if the section isn't there
+	uint64_t xOffset;
+	uint64_t yOffset;
+	uint64_t idOffset;
+	uint64_t boundsOffset;
+};
+static_assert(sizeof(PointFileHeader) == pointFileAlignment, "the point file header should take up exactly one aligned section");
+
+struct PointChunkBounds {
+	int32_t minX, minY, maxX, maxY;
+};
+
+inline uint64_t alignPointFileOffset(uint64_t offset) {
+	return (offset + pointFileAlignment - 1) / pointFileAlignment * pointFileAlignment;
+}
+
+//bounding box of each chunk of points
+inline std::vector<PointChunkBounds> computeChunkBounds(const Point* points, size_t count, uint32_t chunkPoints) {
+	std::vector<PointChunkBounds> bounds;
+	for (size_t begin = 0; begin < count; begin += chunkPoints) {
+		size_t end = std::min(count, begin + chunkPoints);
+		PointChunkBounds box = { points[begin].x, points[begin].y, points[begin].x, points[begin].y };
+		for (size_t x = begin + 1; x < end; x++) {
+			box.minX = std::min(box.minX, (int32_t)points[x].x);
+			box.minY = std::min(box.minY, (int32_t)points[x].y);
+			box.maxX = std::max(box.maxX, (int32_t)points[x].x);
+			box.maxY = std::max(box.maxY, (int32_t)points[x].y);
+		}
+		bounds.push_back(box);
+	}
+	return bounds;
+}
+
+//writes points to a file. ids can be null, and a chunkPoints of 0 leaves out the chunk bounds.
+//returns false if the file couldn't be written.
+inline bool writePointFile(const std::string& path, const Point* points, size_t count, const uint64_t* ids = nullptr, uint32_t chunkPoints = pointFileChunkPoints) {
+	PointFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, pointFileMagic, sizeof(header.magic));
+	header.version = pointFileVersion;
+	header.pointCount = count;
+
+	std::vector<PointChunkBounds> bounds;
+	if (chunkPoints > 0 && count > 0) {
+		bounds = computeChunkBounds(points, count, chunkPoints);
+		header.flags |= PFF_HasChunkBounds;
+		header.chunkPoints = chunkPoints;
+		header.chunkCount = (uint32_t)bounds.size();
+	}
+	if (ids != nullptr) {
+		header.flags |= PFF_HasIds;
+	}
+
+	uint64_t offset = sizeof(header);
+	header.xOffset = offset;
+	offset = alignPointFileOffset(offset + count * sizeof(int32_t));
+	header.yOffset = offset;
+	offset = alignPointFileOffset(offset + count * sizeof(int32_t));
+	if (ids != nullptr) {
+		header.idOffset = offset;
+		offset = alignPointFileOffset(offset + count * sizeof(uint64_t));
+	}
+	if (!bounds.empty()) {
+		header.boundsOffset = offset;
+	}
+
+	std::ofstream outfile(path, std::ios::binary | std::ios::trunc);
+	if (!outfile.is_open()) {
+		return false;
+	}
+
+	uint64_t written = 0;
+	auto padTo = [&](uint64_t target) {
+		static const char zeros[pointFileAlignment] = {};
+		outfile.write(zeros, target - written);
+		written = target;
+	};
+
+	outfile.write((const char*)&header, sizeof(header));
+	written = sizeof(header);
+
+	//columns are written out a block at a time, so writing doesn't need a second copy of the whole set
+	const size_t blockPoints = 16384;
+	std::vector<int32_t> column(std::min(count, blockPoints));
+	for (int axis = 0; axis < 2; axis++) {
+		padTo(axis == 0 ? header.xOffset : header.yOffset);
+		for (size_t begin = 0; begin < count; begin += blockPoints) {
+			size_t end = std::min(count, begin + blockPoints);
+			for (size_t x = begin; x < end; x++) {
+				column[x - begin] = axis == 0 ? points[x].x : points[x].y;
+			}
+			outfile.write((const char*)column.data(), (end - begin) * sizeof(int32_t));
+			written += (end - begin) * sizeof(int32_t);
+		}
+	}
+	if (ids != nullptr) {
+		padTo(header.idOffset);
+		outfile.write((const char*)ids, count * sizeof(uint64_t));
+		written += count * sizeof(uint64_t);
+	}
+	if (!bounds.empty()) {
+		padTo(header.boundsOffset);
+		outfile.write((const char*)bounds.data(), bounds.size() * sizeof(PointChunkBounds));
+	}
+
+	outfile.flush();
+	return outfile.good();
+}
+
+inline bool writePointFile(const std::string& path, const PointList& points, const std::vector<uint64_t>* ids = nullptr, uint32_t chunkPoints = pointFileChunkPoints) {
+	return writePointFile(path, points.data(), points.size(), ids == nullptr ? nullptr : ids->data(), chunkPoints);
+}
+
+//checks that a header makes sense and every section fits in a file of fileSize bytes
+inline bool validPointFileHeader(const PointFileHeader& header, uint64_t fileSize) {
+	if (memcmp(header.magic, pointFileMagic, sizeof(header.magic)) != 0 || header.version != pointFileVersion) {
+		return false;
+	}
+
+	auto sectionFits = [&](uint64_t offset, uint64_t bytes) {
+		return offset % pointFileAlignment == 0 && offset >= sizeof(PointFileHeader) && offset <= fileSize && bytes <= fileSize - offset;
+	};
+	uint64_t count = header.pointCount;
+	if (count > fileSize / sizeof(int32_t)) {
+		return false;
+	}
+	if (!sectionFits(header.xOffset, count * sizeof(int32_t)) || !sectionFits(header.yOffset, count * sizeof(int32_t))) {
+		return false;
+	}
+	if ((header.flags & PFF_HasIds) && !sectionFits(header.idOffset, count * sizeof(uint64_t))) {
+		return false;
+	}
+	if (header.flags & PFF_HasChunkBounds) {
+		if (header.chunkPoints == 0 || header.chunkCount != (count + header.chunkPoints - 1) / header.chunkPoints) {
+			return false;
+		}
+		if (!sectionFits(header.boundsOffset, (uint64_t)header.chunkCount * sizeof(PointChunkBounds))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//a point file mapped into memory. the columns point straight into the mapping, so they're only valid while this is open.
+class MappedPointFile {
+private:
+	const char* data = nullptr;
+	uint64_t fileSize = 0;
+	PointFileHeader header;
+
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int file = -1;
+#endif
+
+	//checks that the header makes sense and every section fits in the file
+	bool validate() {
+		if (fileSize < sizeof(PointFileHeader)) {
+			return false;
+		}
+		memcpy(&header, data, sizeof(header));
+		return validPointFileHeader(header, fileSize);
+	}
+
+public:
+	MappedPointFile() {
+		memset(&header, 0, sizeof(header));
+	}
+
+	MappedPointFile(const MappedPointFile&) = delete;
+	MappedPointFile& operator=(const MappedPointFile&) = delete;
+
+	~MappedPointFile() {
+		close();
+	}
+
+	//maps the file read-only. returns false if it can't be opened or isn't a valid point file.
+	bool open(const std::string& path) {
+		close();
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		fileSize = (uint64_t)size.QuadPart;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			close();
+			return false;
+		}
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0) {
+			close();
+			return false;
+		}
+		fileSize = (uint64_t)info.st_size;
+		void* memory = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, file, 0);
+		data = memory == MAP_FAILED ? nullptr : (const char*)memory;
+#ifdef MADV_SEQUENTIAL
+		if (data != nullptr) {
+			madvise(memory, fileSize, MADV_SEQUENTIAL);
+		}
+#endif
+#endif
+		if (data == nullptr || !validate()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+#if defined(_WIN32)
+		if (data != nullptr) {
+			UnmapViewOfFile(data);
+		}
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr) {
+			munmap((void*)data, fileSize);
+		}
+		if (file >= 0) {
+			::close(file);
+		}
+		file = -1;
+#endif
+		data = nullptr;
+		fileSize = 0;
+		memset(&header, 0, sizeof(header));
+	}
+
+	bool isOpen() const {
+		return data != nullptr;
+	}
+
+	size_t size() const {
+		return (size_t)header.pointCount;
+	}
+
+	const int32_t* xs() const {
+		return (const int32_t*)(data + header.xOffset);
+	}
+
+	const int32_t* ys() const {
+		return (const int32_t*)(data + header.yOffset);
+	}
+
+	bool hasIds() const {
+		return (header.flags & PFF_HasIds) != 0;
+	}
+
+	//null if the file has no ids
+	const uint64_t* ids() const {
+		return hasIds() ? (const uint64_t*)(data + header.idOffset) : nullptr;
+	}
+
+	bool hasChunkBounds() const {
+		return (header.flags & PFF_HasChunkBounds) != 0;
+	}
+
+	//points per chunk. files without chunk bounds are still split up the same way, so loading them can be spread across threads.
+	size_t chunkPoints() const {
+		return hasChunkBounds() ? header.chunkPoints : pointFileChunkPoints;
+	}
+
+	size_t chunkCount() const {
+		return (size() + chunkPoints() - 1) / chunkPoints();
+	}
+
+	void chunkRange(size_t chunk, size_t& begin, size_t& end) const {
+		begin = chunk * chunkPoints();
+		end = std::min(size(), begin + chunkPoints());
+	}
+
+	//null if the file has no chunk bounds
+	const PointChunkBounds* boundingBoxes() const {
+		return hasChunkBounds() ? (const PointChunkBounds*)(data + header.boundsOffset) : nullptr;
+	}
+
+	Point point(size_t index) const {
+		return Point{ xs()[index], ys()[index] };
+	}
+};
+
+//true if every point of the chunk is strictly inside the hull. the hull is convex, so that's the case exactly when all four corners of the box are.
+inline bool chunkInsideHull(const PointChunkBounds& box, const HullQuery& knownHull) {
+	return knownHull.strictlyContains(Point{ box.minX, box.minY }) && knownHull.strictlyContains(Point{ box.maxX, box.minY })
+		&& knownHull.strictlyContains(Point{ box.minX, box.maxY }) && knownHull.strictlyContains(Point{ box.maxX, box.maxY });
+}
+
+//true if every point the box covers is in the range the engine is exact for
+inline bool chunkInRange(const PointChunkBounds& box) {
+	return pointInRange(Point{ box.minX, box.minY }) && pointInRange(Point{ box.maxX, box.maxY });
+}
+
+//copies the mapped columns into interleaved points. if a known hull is given, chunks that lie strictly inside it are left out,
+//so the result only has the points that could still be on the hull of everything loaded so far (the hull's own points should be added back by the caller).
+//chunksSkipped, if given, is set to the amount of chunks left out. returns false, leaving points empty, if any point is out of range.
+inline bool loadPointFile(Executor& exec, const MappedPointFile& file, PointList& points, const HullQuery* knownHull = nullptr, size_t* chunksSkipped = nullptr) {
+	size_t chunks = file.chunkCount();
+	const PointChunkBounds* bounds = file.boundingBoxes();
+	points.clear();
+	if (bounds != nullptr && !std::all_of(bounds, bounds + chunks, chunkInRange)) {
+		return false;
+	}
+
+	//work out where each kept chunk goes in the output first, so that chunks can be filled in on any thread
+	std::vector<size_t> outputStart(chunks + 1, 0);
+	size_t skipped = 0;
+	for (size_t chunk = 0; chunk < chunks; chunk++) {
+		size_t begin, end;
+		file.chunkRange(chunk, begin, end);
+		bool skip = knownHull != nullptr && !knownHull->empty() && bounds != nullptr && chunkInsideHull(bounds[chunk], *knownHull);
+		skipped += skip;
+		outputStart[chunk + 1] = outputStart[chunk] + (skip ? 0 : end - begin);
+	}
+	if (chunksSkipped != nullptr) {
+		*chunksSkipped = skipped;
+	}
+
+	points.resize(outputStart[chunks]);
+	const int32_t* xs = file.xs();
+	const int32_t* ys = file.ys();
+
+	//the boxes could be missing or wrong, so every copied point is checked as well
+	std::vector<uint8_t> chunkOutOfRange(chunks, 0);
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			file.chunkRange(chunk, begin, end);
+			if (outputStart[chunk + 1] == outputStart[chunk]) {
+				continue;
+			}
+			Point* out = points.data() + outputStart[chunk];
+			bool outOfRange = false;
+			for (size_t x = begin; x < end; x++) {
+				out[x - begin] = Point{ xs[x], ys[x] };
+				outOfRange |= !pointInRange(out[x - begin]);
+			}
+			chunkOutOfRange[chunk] = outOfRange;
+		}
+		});
+	if (std::find(chunkOutOfRange.begin(), chunkOutOfRange.end(), 1) != chunkOutOfRange.end()) {
+		points.clear();
+		return false;
+	}
+	return true;
+}
+
+//loads only the points that could be on the file's hull (see the top of this file). files without chunk bounds are loaded whole.
+//chunksSkipped, if given, is set to the amount of chunks left out. returns false like loadPointFile.
+inline bool loadPointFileHullCandidates(Executor& exec, const MappedPointFile& file, PointList& points, size_t* chunksSkipped = nullptr) {
+	size_t chunks = file.chunkCount();
+	const PointChunkBounds* bounds = file.boundingBoxes();
+	if (bounds == nullptr || chunks < 2 || !std::all_of(bounds, bounds + chunks, chunkInRange)) {
+		if (chunksSkipped != nullptr) {
+			*chunksSkipped = 0;
+		}
+		return loadPointFile(exec, file, points);
+	}
+
+	//the chunk whose box reaches furthest in each of eight directions
+	std::vector<size_t> seedChunks;
+	for (int directionX = -1; directionX <= 1; directionX++) {
+		for (int directionY = -1; directionY <= 1; directionY++) {
+			if (directionX == 0 && directionY == 0) {
+				continue;
+			}
+			size_t best = 0;
+			long long bestReach = 0;
+			for (size_t chunk = 0; chunk < chunks; chunk++) {
+				const PointChunkBounds& box = bounds[chunk];
+				long long reach = (long long)directionX * (directionX < 0 ? box.minX : box.maxX) + (long long)directionY * (directionY < 0 ? box.minY : box.maxY);
+				if (chunk == 0 || reach > bestReach) {
+					best = chunk;
+					bestReach = reach;
+				}
+			}
+			if (std::find(seedChunks.begin(), seedChunks.end(), best) == seedChunks.end()) {
+				seedChunks.push_back(best);
+			}
+		}
+	}
+
+	//their hull
+	PointList seedPoints;
+	for (size_t chunk : seedChunks) {
+		size_t begin, end;
+		file.chunkRange(chunk, begin, end);
+		for (size_t x = begin; x < end; x++) {
+			seedPoints.push_back(file.point(x));
+		}
+	}
+	if (!std::all_of(seedPoints.begin(), seedPoints.end(), pointInRange)) {
+		points.clear();
+		return false;
+	}
+	std::sort(seedPoints.begin(), seedPoints.end(), pointLessThan);
+	std::vector<Point> seedHull = orderHull(computeHullPoints(exec, seedPoints));
+	HullQuery known(seedHull);
+
+	//a seed chunk's box reaches at least as far as every point in its direction, so it can't be strictly inside the seed hull and is never skipped itself
+	return loadPointFile(exec, file, points, &known, chunksSkipped);
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+/*
+Random input points, made with a counter-based generator so they can be made on every core at once.
+
+The generator is Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+Rather than stepping a hidden state forward, it scrambles a 128-bit counter under a 64-bit key into 128 random bits, so any number in the sequence can be made on its own.
+Point i always comes from counter i, so the same seed gives the same points no matter how many threads make them or in what order,
+and there's no global state like rand() has, so two generators never get in each other's way.
+
+Each point takes one block: the first 64 bits pick x and the second 64 pick y, each scaled into its range with a multiply instead of a modulo, so no value comes up more often than any other (to within 2^-32).
+
+Points can be written as a PointList, as separate x and y columns, or already sorted with pointLessThan.
+Sorted output is made by counting how many points land in each strip of x values, then making every point again (they're free to remake) and dropping it straight into its strip,
+which leaves each strip small enough to sort on its own, all at the same time.
+All three work for any function that makes point i from index i alone, which is how the other distributions are made (see distributions.h).
+*/
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "point.h"
+#include "executor.h"
+
+//points per chunk when generating in parallel. big enough that handing a chunk to a thread costs nothing next to making its points.
+const size_t pointGeneratorGrainSize = 16384;
+
+//for sorted output: the smallest chunk and the most chunks, and how many points each strip of x values should hold and the most strips.
+//every chunk keeps a count for every strip, so the two limits keep those counts to a few tens of MB at most.
+const size_t pointGeneratorSortChunk = 65536;
+const size_t pointGeneratorMaxSortChunks = 256;
+const size_t pointGeneratorStripPoints = 4096;
+const size_t pointGeneratorMaxStrips = 16384;
+
+struct PhiloxBlock {
+	uint32_t word[4];
+};
+
+//Philox4x32-10: scrambles a 128-bit counter under a 64-bit key. every distinct counter gives an unrelated block.
+inline PhiloxBlock philox4x32(PhiloxBlock counter, uint64_t key) {
+	const uint32_t multiplier0 = 0xD2511F53u, multiplier1 = 0xCD9E8D57u;
+	const uint32_t weyl0 = 0x9E3779B9u, weyl1 = 0xBB67AE85u;
+	uint32_t key0 = (uint32_t)key, key1 = (uint32_t)(key >> 32);
+
+	for (int round = 0; round < 10; round++) {
+		uint64_t product0 = (uint64_t)multiplier0 * counter.word[0];
+		uint64_t product1 = (uint64_t)multiplier1 * counter.word[2];
+		counter = { {
+			(uint32_t)(product1 >> 32) ^ counter.word[1] ^ key0,
+			(uint32_t)product1,
+			(uint32_t)(product0 >> 32) ^ counter.word[3] ^ key1,
+			(uint32_t)product0
+		} };
+		key0 += weyl0;
+		key1 += weyl1;
+	}
+	return counter;
+}
+
+//scales 64 random bits into [0, range) by taking the top half of random * range, which is unbiased to within range / 2^64
+inline uint32_t philoxBounded(uint64_t random, uint32_t range) {
+	uint64_t high = (random >> 32) * range;
+	uint64_t low = (random & 0xFFFFFFFFu) * range;
+	return (uint32_t)((high + (low >> 32)) >> 32);
+}
+
+inline uint64_t philoxWord64(const PhiloxBlock& block, int half) {
+	return ((uint64_t)block.word[half * 2 + 1] << 32) | block.word[half * 2];
+}
+
+//the top 53 of 64 random bits as a double in [0, 1)
+inline double philoxUnit(uint64_t random) {
+	return (double)(random >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//the area points are made in: x in [minX, maxX), y in [minY, maxY)
+struct GeneratorBounds {
+	int minX, minY, maxX, maxY;
+};
+
+//calls store(index, make(index)) for every index in [0, count), spread across the executor's threads
+template<class Make, class Store>
+void generatePoints(Executor& exec, size_t count, Make make, Store store) {
+	size_t chunks = exec.chunkCount(count, pointGeneratorGrainSize);
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			chunkBounds(count, chunks, chunk, begin, end);
+			for (size_t x = begin; x < end; x++) {
+				store(x, make(x));
+			}
+		}
+		});
+}
+
+//make(index) for every index in [0, count), as a list in index order
+template<class Make>
+PointList generatePointList(Executor& exec, size_t count, Make make) {
+	PointList points(count);
+	Point* out = points.data();
+	generatePoints(exec, count, make, [out](size_t index, Point point) {
+		out[index] = point;
+		});
+	return points;
+}
+
+//the same points as generatePointList, written as separate x and y columns
+template<class Make>
+void generatePointColumns(Executor& exec, size_t count, Make make, int32_t* xs, int32_t* ys) {
+	generatePoints(exec, count, make, [xs, ys](size_t index, Point point) {
+		xs[index] = point.x;
+		ys[index] = point.y;
+		});
+}
+
+//the same points as generatePointList, already sorted with pointLessThan. every point has to be inside bounds.
+template<class Make>
+PointList generateSortedPoints(Executor& exec, size_t count, const GeneratorBounds& bounds, Make make) {
+	PointList points(count);
+	if (count == 0) {
+		return points;
+	}
+
+	//strips of x values, each expected to hold about pointGeneratorStripPoints points. a strip is never narrower than one x value.
+	uint64_t width = (uint64_t)((int64_t)bounds.maxX - bounds.minX);
+	size_t strips = (size_t)std::max<uint64_t>(1, std::min<uint64_t>(std::min(width, (uint64_t)pointGeneratorMaxStrips), count / pointGeneratorStripPoints));
+	auto stripOf = [&](const Point& point) {
+		return (size_t)((uint64_t)((int64_t)point.x - bounds.minX) * strips / width);
+	};
+
+	//the chunks are a fixed size rather than one per thread, so where each point lands doesn't depend on the thread count either
+	size_t chunkSize = std::max(pointGeneratorSortChunk, (count + pointGeneratorMaxSortChunks - 1) / pointGeneratorMaxSortChunks);
+	size_t chunks = (count + chunkSize - 1) / chunkSize;
+	std::vector<uint32_t> counts(chunks * strips, 0);
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			uint32_t* chunkCounts = &counts[chunk * strips];
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t x = chunk * chunkSize; x < end; x++) {
+				chunkCounts[stripOf(make(x))]++;
+			}
+		}
+		});
+
+	//turn the counts into where each chunk starts writing in each strip: strip by strip, and chunk by chunk inside a strip
+	std::vector<size_t> offsets(chunks * strips);
+	std::vector<size_t> stripStarts(strips + 1);
+	size_t total = 0;
+	for (size_t strip = 0; strip < strips; strip++) {
+		stripStarts[strip] = total;
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			offsets[chunk * strips + strip] = total;
+			total += counts[chunk * strips + strip];
+		}
+	}
+	stripStarts[strips] = total;
+
+	Point* out = points.data();
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t* chunkOffsets = &offsets[chunk * strips];
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t x = chunk * chunkSize; x < end; x++) {
+				Point point = make(x);
+				out[chunkOffsets[stripOf(point)]++] = point;
+			}
+		}
+		});
+
+	exec.parallelFor(strips, [&](size_t stripBegin, size_t stripEnd) {
+		for (size_t strip = stripBegin; strip < stripEnd; strip++) {
+			std::sort(out + stripStarts[strip], out + stripStarts[strip + 1], pointLessThan);
+		}
+		});
+	return points;
+}
+
+class PointGenerator {
+private:
+	uint64_t key;
+	uint32_t stream;
+
+public:
+	//different streams under the same seed never share a block, so one seed can feed several inputs
+	PointGenerator(uint64_t seed, uint32_t streamIndex = 0) : key(seed), stream(streamIndex) {}
+
+	//the raw random bits for one index. lanes give more blocks for the same index, for anything needing more than 128 bits.
+	PhiloxBlock block(uint64_t index, uint32_t lane = 0) const {
+		PhiloxBlock counter = { { (uint32_t)index, (uint32_t)(index >> 32), stream, lane } };
+		return philox4x32(counter, key);
+	}
+
+	//point number index. always the same point for the same seed, stream and index.
+	Point uniformPoint(uint64_t index, const GeneratorBounds& bounds) const {
+		PhiloxBlock random = block(index);
+		Point point;
+		point.x = bounds.minX + (int)philoxBounded(philoxWord64(random, 0), (uint32_t)((int64_t)bounds.maxX - bounds.minX));
+		point.y = bounds.minY + (int)philoxBounded(philoxWord64(random, 1), (uint32_t)((int64_t)bounds.maxY - bounds.minY));
+		return point;
+	}
+
+	//count points spread evenly over bounds, in index order
+	PointList uniformPoints(Executor& exec, size_t count, const GeneratorBounds& bounds) const {
+		return generatePointList(exec, count, [&](uint64_t index) { return uniformPoint(index, bounds); });
+	}
+
+	//the same points as uniformPoints, written as separate x and y columns
+	void uniformColumns(Executor& exec, size_t count, const GeneratorBounds& bounds, int32_t* xs, int32_t* ys) const {
+		generatePointColumns(exec, count, [&](uint64_t index) { return uniformPoint(index, bounds); }, xs, ys);
+	}
+
+	//the same points as uniformPoints, already sorted with pointLessThan
+	PointList sortedUniformPoints(Executor& exec, size_t count, const GeneratorBounds& bounds) const {
+		return generateSortedPoints(exec, count, bounds, [&](uint64_t index) { return uniformPoint(index, bounds); });
+	}
+};
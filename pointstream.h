@@ -0,0 +1,358 @@
+#pragma once
+
+/*
+Streaming mode: points come in on stdin, and the ordered hull goes out on stdout, so the program can sit in a shell pipeline
+	zcat points.csv.gz | quickhull --stream > hull.txt
+Input is either text, one point per line as "x,y" (spaces, tabs or semicolons also work as separators, lines starting with # are skipped),
+or with --binary, raw pairs of little-endian int32 x and y.
+Points with a coordinate past +-2^30 (see pointInRange() in segmentclassifier.h) are skipped and counted along with lines that aren't points.
+Output is the same "x,y" lines that outputHullPoints writes to points.txt.
+
+A reader thread pulls the input in big blocks and parses it into chunks of points, while the calling thread folds each finished chunk into a running hull.
+Before a chunk is sorted, every point strictly inside the octagon of the running hull's extreme points (Akl-Toussaint) is dropped, since it can't be on the final hull.
+Once the hull has settled, that's nearly every point, so very little is kept around and the hull is ready as soon as the input ends.
+*/
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <ostream>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "point.h"
+#include "segmentclassifier.h"
+#include "boundedqueue.h"
+#include "hullengine.h"
+
+//bytes asked for per read
+const size_t streamReadSize = 1 << 20;
+
+//points per chunk handed from the reader to the hull
+const size_t streamChunkPoints = 1 << 20;
+
+//chunks the reader is allowed to get ahead by
+const size_t streamQueueChunks = 4;
+
+//parses "x,y" lines of text that may arrive split at any point, keeping what it has of an unfinished line between calls
+class PointTextParser {
+private:
+	long long values[2] = { 0, 0 };
+	int field = 0;
+	bool inNumber = false;
+	bool negative = false;
+	bool lineBad = false;
+	bool comment = false;
+	bool lineEmpty = true;
+	size_t badLines = 0;
+
+	void endNumber() {
+		if (!inNumber) {
+			return;
+		}
+		if (field < 2) {
+			values[field] = negative ? -values[field] : values[field];
+		}
+		field++;
+		inNumber = false;
+		negative = false;
+	}
+
+	void endLine(PointList& out) {
+		endNumber();
+		if (!comment && !lineEmpty) {
+			if (!lineBad && field == 2) {
+				out.push_back(Point{ (int)values[0], (int)values[1] });
+			}
+			else {
+				badLines++;
+			}
+		}
+		values[0] = values[1] = 0;
+		field = 0;
+		inNumber = negative = lineBad = comment = false;
+		lineEmpty = true;
+	}
+
+public:
+	//parses size bytes, adding every finished point to out
+	void feed(const char* data, size_t size, PointList& out) {
+		for (size_t x = 0; x < size; x++) {
+			char c = data[x];
+			if (c == '\n') {
+				endLine(out);
+				continue;
+			}
+			if (comment || lineBad) {
+				continue;
+			}
+			if (c >= '0' && c <= '9') {
+				lineEmpty = false;
+				if (field >= 2) {
+					lineBad = true;
+					continue;
+				}
+				if (!inNumber) {
+					inNumber = true;
+					values[field] = 0;
+				}
+				values[field] = values[field] * 10 + (c - '0');
+
+				//coordinates have to be in the range the engine is exact for (see segmentclassifier.h)
+				if (values[field] > pointCoordinateLimit) {
+					lineBad = true;
+				}
+				continue;
+			}
+			if (c == '-' && !inNumber) {
+				lineEmpty = false;
+				if (negative) {
+					lineBad = true;
+				}
+				negative = true;
+				continue;
+			}
+			if (c == ',' || c == ' ' || c == '\t' || c == ';' || c == '\r') {
+				if (negative && !inNumber) {
+					lineBad = true;
+				}
+				endNumber();
+				continue;
+			}
+			if (c == '#' && lineEmpty) {
+				comment = true;
+				continue;
+			}
+			lineEmpty = false;
+			lineBad = true;
+		}
+	}
+
+	//the input has ended, so a last line without a newline still counts
+	void finish(PointList& out) {
+		endLine(out);
+	}
+
+	//lines that weren't a point, like a header or a typo
+	size_t skippedLines() const {
+		return badLines;
+	}
+};
+
+//parses little-endian int32 pairs that may arrive split at any point
+class PointBinaryParser {
+private:
+	unsigned char partial[sizeof(int32_t) * 2];
+	size_t partialSize = 0;
+	size_t outOfRange = 0;
+
+	void add(Point p, PointList& out) {
+		if (pointInRange(p)) {
+			out.push_back(p);
+		}
+		else {
+			outOfRange++;
+		}
+	}
+
+	static Point decode(const unsigned char* bytes) {
+		uint32_t x = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+		uint32_t y = bytes[4] | (bytes[5] << 8) | (bytes[6] << 16) | ((uint32_t)bytes[7] << 24);
+		return Point{ (int)(int32_t)x, (int)(int32_t)y };
+	}
+
+public:
+	void feed(const char* data, size_t size, PointList& out) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		size_t x = 0;
+
+		//finish a point cut in half by the previous read
+		while (partialSize > 0 && x < size) {
+			partial[partialSize++] = bytes[x++];
+			if (partialSize == sizeof(partial)) {
+				add(decode(partial), out);
+				partialSize = 0;
+			}
+		}
+
+		size_t whole = (size - x) / sizeof(partial);
+		size_t start = out.size();
+		out.resize(start + whole);
+		size_t kept = start;
+		for (size_t point = 0; point < whole; point++) {
+			Point p = decode(bytes + x + point * sizeof(partial));
+			out[kept] = p;
+			kept += pointInRange(p);
+		}
+		outOfRange += start + whole - kept;
+		out.resize(kept);
+		x += whole * sizeof(partial);
+
+		while (x < size) {
+			partial[partialSize++] = bytes[x++];
+		}
+	}
+
+	//binary points are only ever whole or missing bytes, so there's nothing left over to add
+	void finish(PointList&) {
+	}
+
+	//points outside the engine's range are dropped, and so is a final point with some of its bytes missing
+	size_t skippedLines() const {
+		return outOfRange + (partialSize > 0 ? 1 : 0);
+	}
+};
+
+//writes hull points, in the order given, as "x,y" lines (the points.txt format)
+inline void writeHullPoints(std::ostream& out, const std::vector<Point>& hull) {
+	for (const Point& p : hull) {
+		out << p.x << "," << p.y << '\n';
+	}
+}
+
+inline void writeHullPoints(FILE* out, const std::vector<Point>& hull) {
+	std::string text;
+	for (const Point& p : hull) {
+		text += std::to_string(p.x);
+		text += ',';
+		text += std::to_string(p.y);
+		text += '\n';
+	}
+	fwrite(text.data(), 1, text.size(), out);
+	fflush(out);
+}
+
+//keeps the hull of every chunk seen so far, and drops points that can't change it before they're sorted
+class RunningHull {
+private:
+	std::vector<Point> hull;
+
+	//octagon of the hull's extreme points. anything strictly inside it is strictly inside the hull.
+	HullQuery cull;
+
+	void updateCull() {
+		if (hull.size() < 3) {
+			cull = HullQuery();
+			return;
+		}
+
+		//the hull points that go furthest in each of 8 directions
+		auto key = [](const Point& p, int direction) -> long long {
+			switch (direction) {
+			case 0: return p.x;
+			case 1: return (long long)p.x + p.y;
+			case 2: return p.y;
+			case 3: return (long long)p.y - p.x;
+			case 4: return -(long long)p.x;
+			case 5: return -(long long)p.x - p.y;
+			case 6: return -(long long)p.y;
+			default: return (long long)p.x - p.y;
+			}
+		};
+		std::vector<Point> extremes;
+		for (int direction = 0; direction < 8; direction++) {
+			Point best = hull[0];
+			for (const Point& p : hull) {
+				if (key(p, direction) > key(best, direction)) {
+					best = p;
+				}
+			}
+			extremes.push_back(best);
+		}
+		std::sort(extremes.begin(), extremes.end(), pointLessThan);
+		extremes.erase(std::unique(extremes.begin(), extremes.end(), comparePoints), extremes.end());
+		cull = extremes.size() >= 3 ? HullQuery(orderHull(extremes)) : HullQuery();
+	}
+
+public:
+	//folds a chunk of points (in any order) into the hull. the chunk is used as scratch space.
+	void add(Executor& exec, PointList& chunk) {
+		if (!cull.empty()) {
+			TRACE_SCOPE("stream cull");
+			chunk.erase(std::remove_if(chunk.begin(), chunk.end(), [&](const Point& p) { return cull.strictlyContains(p); }), chunk.end());
+		}
+		if (chunk.empty()) {
+			return;
+		}
+
+		chunk.insert(chunk.end(), hull.begin(), hull.end());
+		{
+			TRACE_SCOPE("stream sort");
+			std::sort(chunk.begin(), chunk.end(), pointLessThan);
+		}
+		hull = computeHullPoints(exec, chunk);
+		updateCull();
+	}
+
+	//the hull so far, in order (see orderHull)
+	std::vector<Point> ordered() const {
+		return orderHull(hull);
+	}
+};
+
+struct PointStreamStats {
+	size_t bytesRead = 0;
+	size_t pointsRead = 0;
+	size_t skippedLines = 0;
+};
+
+//reads points from input until it ends, with a reader thread parsing while the hull is being worked out, and returns the ordered hull
+template<class Parser>
+std::vector<Point> streamHullWith(Executor& exec, FILE* input, PointStreamStats& stats) {
+	BoundedQueue<PointList> chunks(streamQueueChunks);
+	Parser parser;
+
+	std::thread reader([&]() {
+		std::vector<char> buffer(streamReadSize);
+		PointList chunk;
+		chunk.reserve(streamChunkPoints);
+		while (true) {
+			size_t bytes = fread(buffer.data(), 1, buffer.size(), input);
+			if (bytes == 0) {
+				break;
+			}
+			stats.bytesRead += bytes;
+			parser.feed(buffer.data(), bytes, chunk);
+			if (chunk.size() >= streamChunkPoints) {
+				stats.pointsRead += chunk.size();
+				chunks.push(std::move(chunk));
+				chunk = PointList();
+				chunk.reserve(streamChunkPoints);
+			}
+		}
+		parser.finish(chunk);
+		stats.pointsRead += chunk.size();
+		stats.skippedLines = parser.skippedLines();
+		if (!chunk.empty()) {
+			chunks.push(std::move(chunk));
+		}
+		chunks.close();
+		});
+
+	RunningHull hull;
+	PointList chunk;
+	while (chunks.pop(chunk)) {
+		hull.add(exec, chunk);
+	}
+	reader.join();
+	return hull.ordered();
+}
+
+inline std::vector<Point> streamHull(Executor& exec, FILE* input, bool binary, PointStreamStats& stats) {
+#if defined(_WIN32)
+	if (binary) {
+		_setmode(_fileno(input), _O_BINARY);
+	}
+#endif
+	if (binary) {
+		return streamHullWith<PointBinaryParser>(exec, input, stats);
+	}
+	return streamHullWith<PointTextParser>(exec, input, stats);
+}
@@ -14,18 +14,83 @@ If you wish to compile the program, you will either need to use said library (I
 or you will need to set the following define to 0.
 
 (Note that the output point list works regardless of whether SFML is used!)
+
+Running the program with --stream skips all of that and makes it usable in a shell pipeline: points are read from stdin, and the ordered hull is written to stdout (see pointstream.h).
+With --serve it runs as a service that answers hull requests over a Unix domain socket instead (see hullservice.h),
+and with --ring it keeps the hull of points another process pushes through shared memory (see sharedring.h).
+--batch works out the hull of every file in a folder or manifest, writing each one to an output folder (see batch.h).
 */
 
 #define USE_SFML 1
 
 /*
 If SFML is enabled, you can use P to reset the input with a new set of points, and Q to take a screenshot (which will be saved as "result.png" in the program directory).
+
+Stepping is done with a C++20 coroutine (see stepper.h) that is just the plain recursive algorithm, paused every time it finds a hull point.
+Set the following define to 0 to use the original hand-written StepData state machine instead.
+*/
+
+#define USE_COROUTINE_STEPPER 1
+
+/*
+Set the following define to 1 to run the micro-benchmarks in benchmark.h instead of the normal program. Results are printed to the console.
+*/
+
+#define RUN_BENCHMARKS 0
+
+/*
+Set the following define to 1 to time each phase of the run (input generation, sorting, partitioning, drawing and so on).
+The timings are saved as "trace.json" when the program ends, which can be opened in chrome://tracing or https://ui.perfetto.dev. See trace.h.
+*/
+
+#define ENABLE_TRACING 0
+
+/*
+Set the following define to 1 to count CPU cycles, instructions, branch misses and cache misses in the main phases (sorting, partitioning, the furthest point search).
+A table is printed when the program ends. This needs Linux and permission to use perf counters; without them only the timings are shown. See perfcounters.h.
+*/
+
+#define ENABLE_PERF_COUNTERS 0
+
+/*
+Set the following define to 1 to count every allocation, per phase of the run, along with the peak resident memory and the most StepData nodes alive at once.
+A summary is printed and saved as "memory_profile.txt" when the program ends. See memprofile.h.
 */
 
+#define ENABLE_MEMORY_PROFILING 0
+
 #include <vector>
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <deque>
+#include <chrono>
+#include <random>
+
+#include "memprofile.h"
+#include "trace.h"
+#include "perfcounters.h"
+#include "point.h"
+#include "segmentclassifier.h"
+#include "hullengine.h"
+#include "pointfile.h"
+#include "pointstream.h"
+#include "hullservice.h"
+#include "sharedring.h"
+#include "hullcache.h"
+#include "checkpoint.h"
+#include "asyncreader.h"
+#include "batch.h"
+#include "stepper.h"
+#include "pointgenerator.h"
+#include "distributions.h"
+#include "grouphull.h"
+#include "tilehull.h"
+#include "anytimehull.h"
+#include "benchmark.h"
 
 #if USE_SFML == 1
 #include <SFML/Window.hpp>
@@ -36,11 +101,14 @@ If SFML is enabled, you can use P to reset the input with a new set of points, a
 The bulk of the logic is inside the step() function, which should be simple to port to another language if necessary.
 
 The program allows one to see the convex hull as it forms, showing the gradual refinement of the hull as it progresses.
-It highlights the current pair, the line it creates, and the current farthest point
+It highlights the current pair, the line it creates, and the current farthest point.
+Points are colored by what's known about them: dark gray until they're first looked at, light gray once they're known to be inside the hull,
+black once they're on it, and orange or blue for the two sides the latest split of their part of the hull put them on.
 
 The code itself is commentated, but for simple adjustments, you can change the values of the variables below.
 
-randSeed: A number used for generating random points, passed into the srand function. Set to 0 to have it generate a completely random input every time it's run.
+randSeed: A number used for generating random points, used as the key of the point generator (see pointgenerator.h). Set to 0 to have it generate a completely random input every time it's run.
+The same seed gives the same points no matter which executor makes them or how many threads it has.
 
 stepTimeMS: The amount of time to wait between each step, in milliseconds. The higher this number is, the longer the wait between steps. This is good for if you need a closer look at each individual step.
 Set this number to a lower one if you just wish to see the result.
@@ -48,15 +116,46 @@ Set this number to a lower one if you just wish to see the result.
 pointCount: The amount of points to create, randomize, and make a hull for. Since Quickhull is O(n log n), you can go much higher with this one.
 At 1 MS step time, 4000 points takes about half a second and 400000 takes about 5, so it's very easy to get to a point where the main bottleneck is the poorly-optimized drawing code
 
-windowWidth/windowHeight: The size of the displayed window. Points are evenly distrubited within the window range, with a bit of a buffer given on the edges.
+windowWidth/windowHeight: The size of the displayed window. Whatever area the input covers is scaled to fit inside it, with a bit of a buffer given on the edges.
+
+worldWidth/worldHeight: The area random points are made in, in world coordinates. These have nothing to do with the window, so they can go up to the engine's full range (about 2^30 either way, see segmentclassifier.h).
 
 Do note that as pointCount gets higher, the random distribution of a rectangle will make it more and more likely that the convex hull will just be 4 points, that being the corners of the rectangle.
+pointDistribution picks something else to make the points with: a disk, a circle, clusters, a ring, a nearly straight line, or Quickhull's worst case (see distributions.h).
+Pressing P in the visualizer moves on to the next one.
 Also note that due to having to store a bunch of data to do the recursion in steps, the amount of memory taken up can increase drastically.
 You won't have memory issues with sane numbers, but anything in the millions range can start causing problems. 40,000,000 points can take up 1.5 GB of memory at max.
 (This is mainly due to the visualizer, as a lot of state information has to be stored between steps.)
 And, with this being a 32-bit program, it's possible to just crash it completely if you try to go too high.
 So it's probably best to keep the number low-ish. Things stop being meaningfully visible at high enough numbers, regardless.
 (And even if not, there's room to optimize. Converting most of the Points and Point vectors to use pointers instead of copy-by-value could theoretically cut the cost in half, but I don't believe it to be necessary for this scale.)
+
+executorType: Which backend runs the hull when the visualizer is off (see executor.h). EX_Fastest times each available backend on a sample of the input and uses the quickest.
+Use EX_Sequential if the program is already being run inside another thread pool.
+
+inputPointFile: A point file (see pointfile.h) to load the input from, instead of generating random points. Leave it empty to use random points.
+Its points can cover any area, since the view is fitted to them the same way.
+With SFML off, a file with chunk bounds only has the chunks that could hold hull points loaded from it.
+
+useAsyncReader: Whether to read inputPointFile with several reads in flight at once (io_uring on Linux, see asyncreader.h) instead of memory mapping it.
+Mapping is fine when the file is already cached in memory, but a file coming off a fast disk loads quicker this way.
+
+useTiledHull: Whether to split the hull up by area instead of by Quickhull's own splits when SFML is off (see tilehull.h).
+Tiles with points all around them are dropped without a second look and the rest are worked on in parallel, so it keeps every thread busy even when the first split is very lopsided.
+
+useHullCache: Whether to keep finished hulls in the "hull_cache" folder (see hullcache.h), so that running again on the same input skips the sort and the recursion and just writes the hull out. Batch mode uses it for every file.
+Only used when SFML is off, since stepping needs the whole computation anyway.
+
+checkpointFile: A file to save the progress of stepping to (see checkpoint.h), every checkpointIntervalSeconds and whenever the program is asked to stop (Ctrl+C or SIGTERM).
+If the file is there when the program starts, it picks up where that run left off instead of making a new input. Leave it empty to turn checkpoints off.
+This only works with USE_COROUTINE_STEPPER set to 0 (or bestFirstStepping on), since the coroutine keeps its unfinished subproblems inside its frames where they can't be saved.
+With SFML off, turning checkpoints on steps through the hull instead of computing it all at once, which is slower but can be stopped and picked up again.
+
+bestFirstStepping: Whether step() should work on the part of the hull that's furthest off next (see anytimehull.h), instead of finishing each part before moving on to the next.
+The hull then fills in evenly all the way around, so stopping early still leaves a good approximation. Checkpoints work with it too, even with USE_COROUTINE_STEPPER set to 1.
+
+anytimeDeadlineMS: With SFML off, how long to spend on the hull before writing out whatever's been found, refining it best-first. Set to 0 to always compute the whole hull.
+How far off the result could still be is printed along with it. An unfinished hull isn't added to the hull cache.
 */
 
 const int randSeed = 1;
@@ -64,17 +163,33 @@ const int randSeed = 1;
 const int stepTimeMS = 300;
 
 const int pointCount = 1000;
+
+const PointDistribution pointDistribution = PD_Uniform;
+
+const ExecutorType executorType = EX_Fastest;
+
+const char* const inputPointFile = "";
+
+const bool useAsyncReader = false;
+
+const bool useTiledHull = false;
+
+const bool useHullCache = false;
+
+const char* const checkpointFile = "";
+const int checkpointIntervalSeconds = 30;
+
+const bool bestFirstStepping = false;
+
+const int anytimeDeadlineMS = 0;
+
 const int windowWidth = 1280;
 const int windowHeight = 720;
 const int windowMargin = 10;
-const int pointXmax = windowWidth - (windowMargin * 2), pointYmax = windowHeight - (windowMargin * 2);
 
+const int worldWidth = 1260;
+const int worldHeight = 700;
 
-//simple point structure. x and y coordinate.
-struct Point {
-	int x;
-	int y;
-};
 
 //Stores progress for recursions, since they have multiple steps and are interrupted as such.
 //FirstIteration is only use for the very first line.
@@ -85,25 +200,75 @@ enum StepDataProgress {
 	SDP_FirstIteration
 };
 
+#if USE_SFML == 1
+//What's known about each input point, shown as its color.
+//SideOne and SideTwo are the two halves the last split of a point's subproblem sent it to, so they're the points still left to check.
+enum PointClass {
+	PCL_Pending,
+	PCL_Eliminated,
+	PCL_SideOne,
+	PCL_SideTwo,
+	PCL_Hull
+};
+
+const sf::Color pointClassColors[] = { sf::Color(0x3F3F3FFF), sf::Color(0xC8C8C8FF), sf::Color(0xFF8C00FF), sf::Color(0x1E90FFFF), sf::Color(0x000000FF) };
+
+//maps world coordinates to the window: scales around the middle of the input so that all of it fits inside the window margin.
+//worked out once per input, so the points themselves never have to change to be drawn.
+struct ViewTransform {
+	double centerX = 0, centerY = 0;
+	double scale = 1;
+
+	sf::Vector2f toScreen(Point p) const {
+		return sf::Vector2f((float)((p.x - centerX) * scale + windowWidth / 2.0), (float)((p.y - centerY) * scale + windowHeight / 2.0));
+	}
+};
+#endif
+
 //complex structure that contains all the data needed to execute one step of quickhull and setup for the next step.
 struct StepData {
-	std::vector<Point> pointSet; //points allocated from the previous step's S1 or S2
+	PointList pointSet; //points allocated from the previous step's S1 or S2
 	Point segmentA, segmentB;
 	StepDataProgress progress;
 
 	//pointers to the left half, right half, and parent data, to emulate recursion properly
 	std::shared_ptr<StepData> recursiveOne, recursiveTwo, prevStep;
+
+#if ENABLE_MEMORY_PROFILING == 1
+	StepData() {
+		MEMORY_STEPDATA_CREATED();
+	}
+
+	~StepData() {
+		MEMORY_STEPDATA_DESTROYED();
+	}
+#endif
 };
 
 class QuickHull {
 private:
-	std::vector<Point> basePointList;
+	PointList basePointList;
 	std::vector<Point> hullPoints;
 
+#if USE_COROUTINE_STEPPER == 1
+	//the paused recursion, and the executor it runs its loops on (stepping is one thread's job anyway)
+	HullStepper stepper;
+	SequentialExecutor stepExecutor;
+#else
 	std::shared_ptr<StepData> nextStep;
 
-	//average of min and max, used for calculating point order counter-clockwise
-	Point center;
+	//subproblems from a resumed checkpoint that come after nextStep's tree is done
+	std::deque<std::shared_ptr<StepData>> pendingSteps;
+#endif
+
+	//the best-first refinement step() uses instead when bestFirstStepping is on, also used to stop at a deadline
+	AnytimeHull anytime;
+	SequentialExecutor anytimeExecutor;
+
+	//key for random inputs, and how many have been made so far. each one gets its own stream, so pressing P still gives new points.
+	uint64_t inputSeed = randSeed != 0 ? (uint64_t)randSeed : ((uint64_t)std::random_device()() << 32) | std::random_device()();
+	uint32_t inputsGenerated = 0;
+	PointDistribution inputDistribution = pointDistribution;
 
 	//mostly stores the location of important points used for drawing.
 	Point minPoint, maxPoint, furthestStore;
@@ -111,8 +276,16 @@ private:
 #if USE_SFML == 1
 	//shape presets used for drawing.
 	sf::CircleShape mainPoint;
-	sf::CircleShape secondaryPoint;
 	sf::CircleShape furthestPoint;
+
+	//every input point is a quad with a circle drawn on it, all in one vertex array so they're drawn at once.
+	//only the colors ever change, and only for the points whose class changed since the last frame.
+	std::vector<uint8_t> pointClasses;
+	sf::VertexArray pointVertices;
+	sf::RenderTexture pointTexture;
+	size_t dirtyBegin = 0, dirtyEnd = 0;
+
+	ViewTransform view;
 #endif
 
 public:
@@ -120,104 +293,152 @@ public:
 #if USE_SFML == 1
 		//create circle shapes used for drawing, their colors, and then center them
 		mainPoint = sf::CircleShape(6, 32);
-		secondaryPoint = sf::CircleShape(6, 32);
 		furthestPoint = sf::CircleShape(6, 32);
 
 		mainPoint.setFillColor(sf::Color(0xFF0000FF));
-		secondaryPoint.setFillColor(sf::Color(0x3F3F3FFF));
 		furthestPoint.setFillColor(sf::Color(0x00FF00FF));
 
 		mainPoint.setOrigin(6, 6);
-		secondaryPoint.setOrigin(6, 6);
 		furthestPoint.setOrigin(6, 6);
+
+		//a white circle, tinted by each point's vertex colors
+		sf::CircleShape circle(6, 32);
+		circle.setFillColor(sf::Color::White);
+		pointTexture.create(12, 12);
+		pointTexture.setSmooth(true);
+		pointTexture.clear(sf::Color::Transparent);
+		pointTexture.draw(circle);
+		pointTexture.display();
 #endif
 	}
 
 	void randomizeInput(int pointCount) {
-		//clear out lists of points from previous input set
-		basePointList.clear();
-		hullPoints.clear();
+		setInput(generateInput(pointCount));
+	}
+
+	//switches random inputs over to the next distribution
+	void nextDistribution() {
+		inputDistribution = ::nextDistribution(inputDistribution);
+		std::cout << "Generating " << distributionName(inputDistribution) << " points" << std::endl;
+	}
 
-		//creates a certain amount of points with random locations inside the window boundary
-		for (int i = 0; i < pointCount; i++) {
-			int x = rand() % pointXmax + windowMargin;
-			int y = rand() % pointYmax + windowMargin;
+	//creates a certain amount of points with random locations inside the window boundary, spread out as inputDistribution says
+	PointList generateInput(int pointCount) {
+		TRACE_SCOPE("randomizeInput generation");
+		MEMORY_PHASE("randomizeInput generation");
+
+		//making points is only arithmetic, so there's nothing for EX_Fastest to time yet
+		std::unique_ptr<Executor> generateExecutor = createExecutor(executorType == EX_Fastest ? EX_ThreadPool : executorType);
+		GeneratorBounds bounds = { 0, 0, worldWidth, worldHeight };
+		return distributionPoints(*generateExecutor, PointGenerator(inputSeed, inputsGenerated++), inputDistribution, pointCount, bounds);
+	}
+
+	//loads points from a point file (see pointfile.h). returns false if the file can't be read, has no points, or has points outside the engine's range.
+	bool loadInputFile(const std::string& path, PointList& points) {
+		TRACE_SCOPE("loadInputFile");
+		MEMORY_PHASE("loadInputFile");
+		if (useAsyncReader) {
+			AsyncFileReader reader;
+			std::cout << "Reading " << path << " with " << reader.name() << std::endl;
+			return loadPointFileAsync(reader, path, points) && !points.empty();
+		}
 
-			Point newPoint;
-			newPoint.x = x;
-			newPoint.y = y;
-			basePointList.push_back(std::move(newPoint));
+		MappedPointFile file;
+		if (!file.open(path) || file.size() == 0) {
+			return false;
 		}
 
+		//loading is just a copy, so there's nothing for EX_Fastest to time yet
+		std::unique_ptr<Executor> loadExecutor = createExecutor(executorType == EX_Fastest ? EX_ThreadPool : executorType);
+#if USE_SFML == 1
+		return loadPointFile(*loadExecutor, file, points);
+#else
+		//with nothing to draw, only the points that could be on the hull are needed, so chunks inside the hull of the outermost ones are skipped (see pointfile.h)
+		size_t chunksSkipped = 0;
+		if (!loadPointFileHullCandidates(*loadExecutor, file, points, &chunksSkipped)) {
+			return false;
+		}
+		if (file.hasChunkBounds()) {
+			std::cout << "Skipped " << chunksSkipped << " of " << file.chunkCount() << " chunks inside the hull of the outermost ones" << std::endl;
+		}
+		return true;
+#endif
+	}
+
+	//uses the given points as the input, in place of random ones. needs at least one point.
+	void setInput(PointList points) {
+		//clear out lists of points from previous input set
+		basePointList = std::move(points);
+		hullPoints.clear();
+
 		//sorts points from left-to-right, top-to-bottom
-		std::sort(basePointList.begin(), basePointList.end(), [](const Point& left, const Point& right) {
-			return (left.x < right.x) || (left.x == right.x && left.y < right.y);
-			});
+		{
+			TRACE_SCOPE("initial sort");
+			MEMORY_PHASE("initial sort");
+			PERF_SCOPE("initial sort", basePointList.size());
+			std::sort(basePointList.begin(), basePointList.end(), pointLessThan);
+		}
 
 		//sets up some initial values
 		minPoint = basePointList[0];
 		maxPoint = basePointList[basePointList.size() - 1];
 
+#if USE_SFML == 1
+		fitView();
+		resetPointClasses();
+#endif
+
+		if (bestFirstStepping) {
+			anytime.start(anytimeExecutor, basePointList);
+		}
+#if USE_COROUTINE_STEPPER == 1
+		//starts the recursion off. it doesn't run until the first step.
+		stepper = stepHullFromStart(stepExecutor, basePointList);
+#else
 		//creates first step with a full point list, and manually sets up its recursion steps
+		pendingSteps.clear();
 		nextStep = std::make_shared<StepData>();
 		nextStep->pointSet = basePointList;
 		nextStep->progress = SDP_FirstIteration;
 		nextStep->segmentA = minPoint;
 		nextStep->segmentB = maxPoint;
 		prepareNextRecursion(nextStep, minPoint, minPoint, maxPoint);
+#endif
 
 		//add first two points to the hull list
 		hullPoints.push_back(minPoint);
 		hullPoints.push_back(maxPoint);
-
-		center.x = windowWidth / 2;
-		center.y = windowHeight / 2;
-	}
-
-	bool comparePoints(const Point lhs, const Point rhs) {
-		return lhs.x == rhs.x && lhs.y == rhs.y;
+#if USE_SFML == 1
+		classifyPoint(minPoint, PCL_Hull);
+		classifyPoint(maxPoint, PCL_Hull);
+#endif
 	}
 
-	std::vector<Point> calcPointsOnRightSide(Point begin, Point end, const std::vector<Point>& list) {
-		std::vector<Point> temp;
+	PointList calcPointsOnRightSide(Point begin, Point end, const PointList& list) {
+		PERF_SCOPE("calcPointsOnRightSide", list.size());
+		PointList temp;
+		SegmentClassifier line(begin, end);
 		for (int x = 0; x < list.size(); x++) {
 			if (comparePoints(list[x], begin) || comparePoints(list[x], end)) {
 				continue;
 			}
 			//go through all points that aren't part of the current line and determine their side
-
-			int x1 = begin.x;
-			int y1 = begin.y;
-			int x2 = end.x;
-			int y2 = end.y;
-			int x3 = list[x].x;
-			int y3 = list[x].y;
-
-			//calculate determinant between current point and line points, to determine if on left or right of line
-			int determinant = (x1 * y2) + (x3 * y1) + (x2 * y3) - (x3 * y2) - (x2 * y1) - (x1 * y3);
-
-			if (determinant < 0) {
+			if (line.isRight(list[x])) {
 				temp.push_back(list[x]);
 			}
 		}
 		return temp;
 	}
 
-	Point calculateFurthestPoint(Point segmentA, Point segmentB, const std::vector<Point>& list) {
+	Point calculateFurthestPoint(Point segmentA, Point segmentB, const PointList& list) {
+		TRACE_SCOPE("calculateFurthestPoint");
+		PERF_SCOPE("calculateFurthestPoint", list.size());
 		Point furthest = list[0]; //Default value
-		int prevMax = -1;
+		long long prevMax = -1;
+		SegmentClassifier line(segmentA, segmentB);
 		for (int x = 0; x < list.size(); x++) {
-			//go through all points that aren't part of the current line and determine their side
-
-			int x1 = segmentA.x;
-			int y1 = segmentA.y;
-			int x2 = segmentB.x;
-			int y2 = segmentB.y;
-			int x3 = list[x].x;
-			int y3 = list[x].y;
-
-			//calculate determinant between current point and line points, to determine distance
-			int determinant = abs((x1 * y2) + (x3 * y1) + (x2 * y3) - (x3 * y2) - (x2 * y1) - (x1 * y3));
+			//go through all points that aren't part of the current line and determine their distance
+			long long determinant = std::llabs(line.side(list[x]));
 
 			if (determinant > prevMax) {
 				prevMax = determinant;
@@ -237,16 +458,22 @@ public:
 		rightStep->progress = SDP_RecurseOne;
 
 		//go through all points and sort into proper sides based off the given lines
-		leftStep->pointSet = calcPointsOnRightSide(P, C, currentStep->pointSet);
-		rightStep->pointSet = calcPointsOnRightSide(C, Q, currentStep->pointSet);
+		{
+			TRACE_SCOPE("prepareNextRecursion partition");
+			leftStep->pointSet = calcPointsOnRightSide(P, C, currentStep->pointSet);
+			rightStep->pointSet = calcPointsOnRightSide(C, Q, currentStep->pointSet);
+		}
 
 		//Sort the point lists of the left and right steps by order, left-to-right, top-to-bottom
-		std::sort(leftStep->pointSet.begin(), leftStep->pointSet.end(), [](const Point& left, const Point& right) {
-			return (left.x < right.x) || (left.x == right.x && left.y < right.y);
-			});
-		std::sort(rightStep->pointSet.begin(), rightStep->pointSet.end(), [](const Point& left, const Point& right) {
-			return (left.x < right.x) || (left.x == right.x && left.y < right.y);
-			});
+		{
+			TRACE_SCOPE("prepareNextRecursion sort");
+			std::sort(leftStep->pointSet.begin(), leftStep->pointSet.end(), pointLessThan);
+			std::sort(rightStep->pointSet.begin(), rightStep->pointSet.end(), pointLessThan);
+		}
+
+#if USE_SFML == 1
+		classifySplit(currentStep->pointSet, leftStep->pointSet, rightStep->pointSet, C);
+#endif
 
 		//Set up split lines
 		leftStep->segmentA = P;
@@ -264,6 +491,27 @@ public:
 	}
 
 	bool step() {
+		MEMORY_PHASE("step");
+		if (bestFirstStepping) {
+			return stepBestFirst();
+		}
+#if USE_COROUTINE_STEPPER == 1
+		//the coroutine does the actual work, so all that's left is recording what it found
+		if (!stepper.next()) {
+			return false;
+		}
+
+		const StepEvent& event = stepper.event();
+		minPoint = event.minPoint;
+		maxPoint = event.maxPoint;
+		furthestStore = event.furthest;
+		hullPoints.push_back(event.furthest);
+#if USE_SFML == 1
+		classifySplit(*event.pointSet, *event.setOne, *event.setTwo, event.furthest);
+#endif
+
+		return true;
+#else
 		//this function is very complicated because i had to do a lot of workarounds to make it so that the recursion process could be individually stepped.
 		//a more standard c++ implementation would be far simpler, but that's the price you pay for cool visuals, i suppose.
 
@@ -281,13 +529,19 @@ public:
 			nextStep->recursiveTwo = nullptr;
 
 			if (nextStep->prevStep == nullptr) {
-				return false;
+				//a resumed run carries on with the rest of its checkpoint's subproblems
+				if (pendingSteps.empty()) {
+					return false;
+				}
+				nextStep = pendingSteps.front();
+				pendingSteps.pop_front();
+				continue;
 			}
 			nextStep = nextStep->prevStep;
 		}
 
 		//alias for convenience
-		std::vector<Point>& stepPoints = nextStep->pointSet;
+		PointList& stepPoints = nextStep->pointSet;
 
 		//stepPoints is already sorted so min and max is easy
 		minPoint = stepPoints[0];
@@ -316,30 +570,174 @@ public:
 			break;
 		}
 
+		return true;
+#endif
+	}
+
+	//one step of best-first refinement: the point that's furthest outside the hull so far
+	bool stepBestFirst() {
+		if (!anytime.refine(anytimeExecutor)) {
+			return false;
+		}
+
+		const StepEvent& event = anytime.event();
+		minPoint = event.minPoint;
+		maxPoint = event.maxPoint;
+		furthestStore = event.furthest;
+		hullPoints.push_back(event.furthest);
+#if USE_SFML == 1
+		classifySplit(*event.pointSet, *event.setOne, *event.setTwo, event.furthest);
+#endif
+
 		return true;
 	}
 
-	//uses arctan to find angle
-	float calculateAngleFromPoints(Point A, Point B) {
-		Point pointDifference;
-		pointDifference.x = A.x - B.x;
-		pointDifference.y = A.y - B.y;
-		double radianAngle = atan2(pointDifference.y, pointDifference.x);
-		return (180.f / 3.14159f) * radianAngle;
+	//refines the hull best-first with the given executor until it's done or the deadline passes. returns whether it's done.
+	bool refineUntil(Executor& exec, std::chrono::steady_clock::time_point deadline) {
+		TRACE_SCOPE("refineUntil");
+		MEMORY_PHASE("refineUntil");
+		if (!bestFirstStepping) {
+			anytime.start(exec, basePointList);
+		}
+		anytime.refineUntil(exec, deadline);
+		hullPoints = anytime.getHullPoints();
+		return anytime.done();
 	}
 
-	std::vector<Point> sortPointsCounterclockwise(std::vector<Point> list, Point center) {
-		std::vector<Point> temp = list;
-		std::sort(temp.begin(), temp.end(), [&](const Point& left, const Point& right) {
-			return calculateAngleFromPoints(center, left) < calculateAngleFromPoints(center, right);
-			});
+	//no input point is further than this from the best-first hull so far (see anytimehull.h)
+	double currentError() const {
+		return anytime.currentError();
+	}
 
-		return temp;
+	//runs the remaining steps without drawing anything in between
+	void finishSteps() {
+		while (step()) {
+		}
+	}
+
+	//everything step() still has to do, for saving to a checkpoint file
+	HullCheckpoint makeCheckpoint() const {
+		if (bestFirstStepping) {
+			return anytime.checkpoint();
+		}
+
+		HullCheckpoint checkpoint;
+#if USE_COROUTINE_STEPPER == 0
+		checkpoint.hullPoints = hullPoints;
+
+		auto addStep = [&](const std::shared_ptr<StepData>& stepData) {
+			if (stepData != nullptr && !stepData->pointSet.empty()) {
+				checkpoint.steps.push_back(CheckpointStep{ stepData->segmentA, stepData->segmentB, stepData->pointSet });
+			}
+		};
+
+		//subproblems are listed in the order step() gets to them: whatever's left of the current node first
+		switch (nextStep->progress) {
+		case SDP_FirstIteration:
+			addStep(nextStep->recursiveOne);
+			addStep(nextStep->recursiveTwo);
+			break;
+		case SDP_RecurseOne:
+			addStep(nextStep);
+			break;
+		case SDP_RecurseTwo:
+			addStep(nextStep->recursiveTwo);
+			break;
+		case SDP_Done:
+			break;
+		}
+
+		//then the second half of every ancestor still waiting on it, nearest first. finished ancestors have nothing left.
+		for (std::shared_ptr<StepData> ancestor = nextStep->prevStep; ancestor != nullptr; ancestor = ancestor->prevStep) {
+			if (ancestor->progress == SDP_RecurseTwo) {
+				addStep(ancestor->recursiveTwo);
+			}
+		}
+
+		for (const std::shared_ptr<StepData>& pending : pendingSteps) {
+			addStep(pending);
+		}
+#endif
+		return checkpoint;
+	}
+
+	//picks up stepping from a checkpoint. only the points that could still be on the hull are left, so those are all that get drawn.
+	void resumeFrom(HullCheckpoint checkpoint) {
+		if (bestFirstStepping) {
+			anytime.resume(anytimeExecutor, checkpoint);
+		}
+		hullPoints = std::move(checkpoint.hullPoints);
+		basePointList.assign(hullPoints.begin(), hullPoints.end());
+#if USE_COROUTINE_STEPPER == 0
+		pendingSteps.clear();
+#endif
+		for (CheckpointStep& saved : checkpoint.steps) {
+			basePointList.insert(basePointList.end(), saved.pointSet.begin(), saved.pointSet.end());
+
+#if USE_COROUTINE_STEPPER == 0
+			std::shared_ptr<StepData> stepData = std::make_shared<StepData>();
+			stepData->pointSet = std::move(saved.pointSet);
+			stepData->segmentA = saved.segmentA;
+			stepData->segmentB = saved.segmentB;
+			stepData->progress = SDP_RecurseOne;
+			pendingSteps.push_back(stepData);
+#endif
+		}
+		std::sort(basePointList.begin(), basePointList.end(), pointLessThan);
+
+#if USE_COROUTINE_STEPPER == 0
+		//a finished run still needs a node to step, which just reports that it's done
+		if (pendingSteps.empty()) {
+			nextStep = std::make_shared<StepData>();
+			nextStep->progress = SDP_Done;
+		}
+		else {
+			nextStep = pendingSteps.front();
+			pendingSteps.pop_front();
+		}
+#endif
+
+		if (!basePointList.empty()) {
+			minPoint = basePointList[0];
+			maxPoint = basePointList[basePointList.size() - 1];
+		}
+
+#if USE_SFML == 1
+		fitView();
+		resetPointClasses();
+		for (const Point& p : hullPoints) {
+			classifyPoint(p, PCL_Hull);
+		}
+#endif
+	}
+
+	//uses a hull that's already known (from the hull cache) as the result, without any input to step through
+	void setCachedHull(std::vector<Point> hull) {
+		basePointList.clear();
+		hullPoints = std::move(hull);
+	}
+
+	const std::vector<Point>& getHullPoints() const {
+		return hullPoints;
+	}
+
+	//computes the whole hull in one go instead of stepping through it, spreading the work out with the given executor.
+	//used when there's nothing to draw, since the visualizer needs the intermediate steps.
+	void computeHull(Executor& exec) {
+		TRACE_SCOPE("computeHull");
+		MEMORY_PHASE("computeHull");
+		hullPoints = useTiledHull ? computeTiledHull(exec, basePointList) : computeHullPoints(exec, basePointList);
+	}
+
+	const PointList& getBasePointList() const {
+		return basePointList;
 	}
 
 	void outputHullPoints() {
-		//Sort points
-		std::vector<Point> sortedPoints = sortPointsCounterclockwise(hullPoints, center);
+		TRACE_SCOPE("outputHullPoints");
+		MEMORY_PHASE("outputHullPoints");
+		//put the points in order around the hull
+		std::vector<Point> sortedPoints = orderHull(hullPoints);
 
 		//Now write to file
 		std::ofstream outfile;
@@ -347,9 +745,7 @@ public:
 		outfile.open("points.txt");
 
 		if (outfile) {
-			for (int x = 0; x < sortedPoints.size(); x++) {
-				outfile << sortedPoints[x].x << "," << sortedPoints[x].y << '\n';
-			}
+			writeHullPoints(outfile, sortedPoints);
 			outfile.flush();
 			outfile.close();
 		}
@@ -359,19 +755,110 @@ public:
 	}
 
 #if USE_SFML == 1
+	//centers the view on the input and scales it to fit the window, keeping its proportions
+	void fitView() {
+		if (basePointList.empty()) {
+			view = ViewTransform();
+			return;
+		}
+		//the list is sorted, so only y needs looking for
+		int minY = basePointList[0].y, maxY = basePointList[0].y;
+		for (const Point& p : basePointList) {
+			minY = std::min(minY, p.y);
+			maxY = std::max(maxY, p.y);
+		}
+		double width = (double)basePointList.back().x - basePointList.front().x;
+		double height = (double)maxY - minY;
+		view.centerX = ((double)basePointList.front().x + basePointList.back().x) / 2;
+		view.centerY = ((double)minY + maxY) / 2;
+		view.scale = std::min((windowWidth - windowMargin * 2) / std::max(width, 1.0), (windowHeight - windowMargin * 2) / std::max(height, 1.0));
+	}
+
+	//marks every point as pending and sets up its quad. done once per input, since after that only the colors change.
+	void resetPointClasses() {
+		pointClasses.assign(basePointList.size(), PCL_Pending);
+		pointVertices = sf::VertexArray(sf::Quads, basePointList.size() * 4);
+		for (size_t x = 0; x < basePointList.size(); x++) {
+			sf::Vector2f position = view.toScreen(basePointList[x]);
+			sf::Vertex* quad = &pointVertices[x * 4];
+			quad[0].position = position + sf::Vector2f(-6, -6);
+			quad[1].position = position + sf::Vector2f(6, -6);
+			quad[2].position = position + sf::Vector2f(6, 6);
+			quad[3].position = position + sf::Vector2f(-6, 6);
+			quad[0].texCoords = sf::Vector2f(0, 0);
+			quad[1].texCoords = sf::Vector2f(12, 0);
+			quad[2].texCoords = sf::Vector2f(12, 12);
+			quad[3].texCoords = sf::Vector2f(0, 12);
+		}
+		dirtyBegin = 0;
+		dirtyEnd = basePointList.size();
+	}
+
+	void setPointClass(size_t index, PointClass pointClass) {
+		if (pointClasses[index] == pointClass) {
+			return;
+		}
+		pointClasses[index] = pointClass;
+		dirtyBegin = std::min(dirtyBegin, index);
+		dirtyEnd = std::max(dirtyEnd, index + 1);
+	}
+
+	//sets the class of every copy of each point. points has to be sorted with pointLessThan, so the search for each one can start where the last one was found.
+	void classifyPoints(const PointList& points, PointClass pointClass) {
+		PointList::const_iterator position = basePointList.begin();
+		for (const Point& p : points) {
+			position = std::lower_bound(position, basePointList.cend(), p, pointLessThan);
+			for (PointList::const_iterator match = position; match != basePointList.cend() && comparePoints(*match, p); ++match) {
+				setPointClass(match - basePointList.cbegin(), pointClass);
+			}
+		}
+	}
+
+	void classifyPoint(Point p, PointClass pointClass) {
+		PointList::const_iterator match = std::lower_bound(basePointList.cbegin(), basePointList.cend(), p, pointLessThan);
+		for (; match != basePointList.cend() && comparePoints(*match, p); ++match) {
+			setPointClass(match - basePointList.cbegin(), pointClass);
+		}
+	}
+
+	//colors a subproblem that was just split around furthest: the two halves it went into, the new hull point, and the rest as eliminated.
+	//this goes over the same points the split itself did, so it never adds more than a constant factor to a step.
+	void classifySplit(const PointList& pointSet, const PointList& sideOne, const PointList& sideTwo, Point furthest) {
+		TRACE_SCOPE("classifySplit");
+		classifyPoints(pointSet, PCL_Eliminated);
+		classifyPoints(sideOne, PCL_SideOne);
+		classifyPoints(sideTwo, PCL_SideTwo);
+		classifyPoint(furthest, PCL_Hull);
+	}
+
+	//copies the classes that changed since the last frame into the vertex colors
+	void updatePointColors() {
+		for (size_t x = dirtyBegin; x < dirtyEnd; x++) {
+			sf::Color color = pointClassColors[pointClasses[x]];
+			sf::Vertex* quad = &pointVertices[x * 4];
+			quad[0].color = color;
+			quad[1].color = color;
+			quad[2].color = color;
+			quad[3].color = color;
+		}
+		dirtyBegin = pointClasses.size();
+		dirtyEnd = 0;
+	}
+
 	//helper function for drawing a line with a given width and color
 	void drawLine(sf::RenderTarget& canvas, Point start, Point end, float lineWidth, sf::Color lineColor) {
-		sf::Vector2f difference = sf::Vector2f(end.x - start.x, end.y - start.y);
+		sf::Vector2f screenStart = view.toScreen(start), screenEnd = view.toScreen(end);
+		sf::Vector2f difference = screenEnd - screenStart;
 		float differenceMagnitude = sqrtf(difference.x * difference.x + difference.y * difference.y);
 		sf::Vector2f normalized = difference / differenceMagnitude;
 		sf::Vector2f lineVisualOffset = sf::Vector2f(-normalized.y, normalized.x) * lineWidth;
 
 		sf::VertexArray lineVisual = sf::VertexArray(sf::Quads, 4);
 
-		lineVisual[0].position = sf::Vector2f(start.x, start.y) + lineVisualOffset;
-		lineVisual[1].position = sf::Vector2f(start.x, start.y) - lineVisualOffset;
-		lineVisual[2].position = sf::Vector2f(end.x, end.y) - lineVisualOffset;
-		lineVisual[3].position = sf::Vector2f(end.x, end.y) + lineVisualOffset;
+		lineVisual[0].position = screenStart + lineVisualOffset;
+		lineVisual[1].position = screenStart - lineVisualOffset;
+		lineVisual[2].position = screenEnd - lineVisualOffset;
+		lineVisual[3].position = screenEnd + lineVisualOffset;
 
 		lineVisual[0].color = lineColor;
 		lineVisual[1].color = lineColor;
@@ -383,47 +870,204 @@ public:
 
 	//draws result to the window
 	void render(sf::RenderTarget& canvas) {
+		TRACE_SCOPE("render");
+		MEMORY_PHASE("render");
 
 		const float lineWidth = 4;
 
 		//get an ordered set of points, and use them to draw lines
-		std::vector<Point> sortedPoints = sortPointsCounterclockwise(hullPoints, center);
+		std::vector<Point> sortedPoints = orderHull(hullPoints);
 		for (int x = 0; x < sortedPoints.size() - 1; x++) {
 			drawLine(canvas, sortedPoints[x], sortedPoints[x + 1], lineWidth, sf::Color::Black);
 		}
 		drawLine(canvas, sortedPoints[sortedPoints.size() - 1], sortedPoints[0], lineWidth, sf::Color::Blue);
 
 
-		//Draw all points
-		for (Point p : basePointList) {
-			secondaryPoint.setPosition(p.x, p.y);
-			canvas.draw(secondaryPoint);
+		//Draw all points, colored by what's known about them
+		if (dirtyBegin < dirtyEnd) {
+			updatePointColors();
 		}
+		sf::RenderStates pointStates;
+		pointStates.texture = &pointTexture.getTexture();
+		canvas.draw(pointVertices, pointStates);
 
 		//now draw the current min and max points over the previous points
-		mainPoint.setPosition(minPoint.x, minPoint.y);
+		mainPoint.setPosition(view.toScreen(minPoint));
 		canvas.draw(mainPoint);
-		mainPoint.setPosition(maxPoint.x, maxPoint.y);
+		mainPoint.setPosition(view.toScreen(maxPoint));
 		canvas.draw(mainPoint);
 
-		furthestPoint.setPosition(furthestStore.x, furthestStore.y);
+		furthestPoint.setPosition(view.toScreen(furthestStore));
 		canvas.draw(furthestPoint);
 	}
 #endif
 };
 
-int main() {
-	//Seed random number generator
-	srand(randSeed);
+//loads inputPointFile if one is set, and otherwise (or if it can't be loaded) makes a new set of random points
+PointList createInput(QuickHull& QH) {
+	PointList points;
+	if (inputPointFile[0] != '\0') {
+		if (QH.loadInputFile(inputPointFile, points)) {
+			return points;
+		}
+		std::cout << "Error: Unable to load " << inputPointFile << ", using random points instead." << std::endl;
+	}
+	return QH.generateInput(pointCount);
+}
+
+//whether step()'s unfinished work can be saved at all: the coroutine's can't, unless stepping is best-first
+constexpr bool checkpointsSupported() {
+	return USE_COROUTINE_STEPPER == 0 || bestFirstStepping;
+}
+
+//loads checkpointFile into QH, if an earlier run left one behind. returns false if there's nothing to resume.
+bool resumeCheckpoint(QuickHull& QH) {
+	HullCheckpoint checkpoint;
+	if (!checkpointsSupported() || checkpointFile[0] == '\0' || !loadCheckpoint(checkpointFile, checkpoint)) {
+		return false;
+	}
+	std::cout << "Resuming from " << checkpointFile << " with " << checkpoint.hullPoints.size() << " hull points found and "
+		<< checkpoint.pendingPoints() << " points left in " << checkpoint.steps.size() << " subproblems" << std::endl;
+	QH.resumeFrom(std::move(checkpoint));
+	return true;
+}
+
+//saves the progress of a stepped run to checkpointFile every checkpointIntervalSeconds, and once more when the program is asked to stop
+class CheckpointTimer {
+private:
+	std::chrono::steady_clock::time_point lastSave = std::chrono::steady_clock::now();
+
+	void save(const QuickHull& QH) {
+		if (!saveCheckpoint(checkpointFile, QH.makeCheckpoint())) {
+			std::cout << "Error: Unable to write " << checkpointFile << std::endl;
+		}
+	}
+
+public:
+	CheckpointTimer() {
+		if (checkpointFile[0] == '\0') {
+			return;
+		}
+		if (enabled()) {
+			installCheckpointSignalHandlers();
+		}
+		else {
+			std::cout << "Checkpoints need USE_COROUTINE_STEPPER set to 0 or bestFirstStepping on, so none will be saved." << std::endl;
+		}
+	}
+
+	static bool enabled() {
+		return checkpointFile[0] != '\0' && checkpointsSupported();
+	}
+
+	//call after every step. returns false once the program has been asked to stop, after saving its progress.
+	bool update(const QuickHull& QH) {
+		if (!enabled()) {
+			return true;
+		}
+		bool stopping = checkpointStopRequested();
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (stopping || now - lastSave >= std::chrono::seconds(checkpointIntervalSeconds)) {
+			save(QH);
+			lastSave = now;
+		}
+		return !stopping;
+	}
+
+	//the hull is done, so there's nothing left to resume
+	void finish() {
+		if (enabled()) {
+			std::remove(checkpointFile);
+		}
+	}
+};
+
+//steps through the rest of the hull, checkpointing along the way. returns false if the program was asked to stop before it was done.
+bool runCheckpointedSteps(QuickHull& QH, CheckpointTimer& checkpoints) {
+	while (QH.step()) {
+		if (!checkpoints.update(QH)) {
+			return false;
+		}
+	}
+	checkpoints.finish();
+	return true;
+}
+
+//--stream mode: reads points from stdin and writes the ordered hull to stdout (see pointstream.h). anything else goes to stderr.
+int runStreamMode(bool binary) {
+	std::unique_ptr<Executor> executor = createExecutor(executorType == EX_Fastest ? EX_ThreadPool : executorType);
+	PointStreamStats stats;
+	std::vector<Point> hull = streamHull(*executor, stdin, binary, stats);
+	writeHullPoints(stdout, hull);
+
+	if (stats.skippedLines > 0) {
+		std::cerr << "Skipped " << stats.skippedLines << " lines that weren't points or were out of range" << std::endl;
+	}
+	TRACE_WRITE("trace.json");
+	PERF_REPORT();
+	MEMORY_REPORT("memory_profile.txt");
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	//"--stream" reads points from stdin instead, and "--stream --binary" reads them as raw int32 pairs
+	if (argc > 1 && strcmp(argv[1], "--stream") == 0) {
+		return runStreamMode(argc > 2 && strcmp(argv[2], "--binary") == 0);
+	}
+
+	//"--serve [socket]" runs the hull service, and "--loadgen [socket] [clients] [requests per client] [points per request]" tests one (see hullservice.h)
+	if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+		std::unique_ptr<Executor> executor = createExecutor(executorType == EX_Fastest ? EX_ThreadPool : executorType);
+		return runHullService(*executor, argc > 2 ? argv[2] : hullServiceDefaultSocket);
+	}
+	if (argc > 1 && strcmp(argv[1], "--loadgen") == 0) {
+		return runHullLoadGenerator(argc > 2 ? argv[2] : hullServiceDefaultSocket, argc > 3 ? atoi(argv[3]) : 8, argc > 4 ? atoi(argv[4]) : 2000, argc > 5 ? atoi(argv[5]) : 100);
+	}
+
+	//"--ring [name]" keeps a hull of points pushed through shared memory, and "--ring-produce [name] [points]" pushes some (see sharedring.h)
+	if (argc > 1 && strcmp(argv[1], "--ring") == 0) {
+		std::unique_ptr<Executor> executor = createExecutor(executorType == EX_Fastest ? EX_ThreadPool : executorType);
+		if (!runRingConsumer(*executor, argc > 2 ? argv[2] : sharedRingDefaultName)) {
+			std::cout << "Error: Unable to create the shared memory ring" << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--ring-produce") == 0) {
+		return runRingProducer(argc > 2 ? argv[2] : sharedRingDefaultName, argc > 3 ? strtoull(argv[3], nullptr, 10) : 10000000);
+	}
+
+	//"--batch <folder or manifest> [output folder]" hulls a whole set of files (see batch.h)
+	if (argc > 2 && strcmp(argv[1], "--batch") == 0) {
+		std::unique_ptr<HullCache> batchCache;
+		if (useHullCache) {
+			batchCache = std::make_unique<HullCache>();
+		}
+		int exitCode = runBatch(argv[2], argc > 3 ? argv[3] : batchDefaultOutputDirectory, batchCache.get());
+		if (batchCache) {
+			batchCache->printReport();
+		}
+		return exitCode;
+	}
+
+#if RUN_BENCHMARKS == 1
+	runBenchmarks();
+	return 0;
+#endif
 
 	//Create class to calculate hull
 	QuickHull QH = QuickHull();
-	QH.randomizeInput(pointCount);
+	CheckpointTimer checkpoints;
+
+#if USE_SFML == 1
+	//an unfinished run left behind in a checkpoint is picked up instead of starting over
+	if (!resumeCheckpoint(QH)) {
+		QH.setInput(createInput(QH));
+	}
 
 	//Variable to stop updating and re-drawing the points once the hull is complete
 	bool continueLoop = true;
 
-#if USE_SFML == 1
 	//boilerplate to create window for display
 	sf::RenderWindow m_window;
 	m_window.create(sf::VideoMode(windowWidth, windowHeight), "Convex Hull QuickHull", sf::Style::Default);
@@ -432,7 +1076,7 @@ int main() {
 
 	//Main loop
 	while (m_window.isOpen()) {
-		//Boilerplate that makes window run and resets points if P is pressed
+		//Boilerplate that makes window run and makes new points from the next distribution if P is pressed
 		while (m_window.pollEvent(m_event)) {
 			switch (m_event.type) {
 			case sf::Event::Closed:
@@ -440,7 +1084,8 @@ int main() {
 				break;
 			case sf::Event::KeyPressed:
 				if (m_event.key.code == sf::Keyboard::P) {
-					QH.randomizeInput(pointCount);
+					QH.nextDistribution();
+					QH.setInput(createInput(QH));
 					continueLoop = true;
 				}
 				if (m_event.key.code == sf::Keyboard::Q) {
@@ -456,6 +1101,12 @@ int main() {
 		if (continueLoop) {
 			//Main logic, calculates one pair of points per step
 			continueLoop = QH.step();
+			if (!continueLoop) {
+				checkpoints.finish();
+			}
+			else if (!checkpoints.update(QH)) {
+				m_window.close();
+			}
 
 			//Boilerplate for displaying result
 			m_window.clear(sf::Color::White);
@@ -476,13 +1127,80 @@ int main() {
 		else {
 			//Just so that it doesn't run at an absurdly high framerate and eat up CPU
 			sf::sleep(sf::milliseconds(30));
+
+			//Ctrl+C goes to the checkpoint handler once it's installed, so the window has to close itself
+			if (checkpointStopRequested()) {
+				m_window.close();
+			}
 		}
 	}
+
+	TRACE_WRITE("trace.json");
+	PERF_REPORT();
+	MEMORY_REPORT("memory_profile.txt");
 #else
-	while (continueLoop) {
-		continueLoop = QH.step();
+	bool resumed = resumeCheckpoint(QH);
+
+	//the cache is keyed on the points as they were made, so it's checked before they're sorted. a resumed run doesn't have them anymore.
+	std::unique_ptr<HullCache> cache;
+	uint64_t cacheKey = 0;
+	PointList input;
+	size_t inputSize = 0;
+	std::vector<Point> cachedHull;
+	if (!resumed) {
+		input = createInput(QH);
+		inputSize = input.size();
+		if (useHullCache) {
+			cache = std::make_unique<HullCache>();
+			cacheKey = cache->key(input);
+		}
+	}
+
+	if (cache && cache->lookup(cacheKey, inputSize, cachedHull)) {
+		std::cout << "Using the cached hull" << std::endl;
+		QH.setCachedHull(std::move(cachedHull));
+	}
+	else {
+		if (!resumed) {
+			QH.setInput(std::move(input));
+		}
+		bool complete = true;
+		if (CheckpointTimer::enabled()) {
+			//stepping is far slower than computeHull, but it can be stopped and picked up again
+			std::cout << "Stepping through the hull, checkpointing to " << checkpointFile << std::endl;
+			if (!runCheckpointedSteps(QH, checkpoints)) {
+				std::cout << "Stopped, progress saved to " << checkpointFile << std::endl;
+				return 0;
+			}
+		}
+		else if (anytimeDeadlineMS > 0) {
+			//refines the worst part of the hull first, so whatever's done by the deadline is as close as it can be
+			std::unique_ptr<Executor> executor = createExecutorForInput(executorType, QH.getBasePointList());
+			std::cout << "Refining the hull best-first for " << anytimeDeadlineMS << " ms with the " << executor->name() << " executor" << std::endl;
+			if (!QH.refineUntil(*executor, std::chrono::steady_clock::now() + std::chrono::milliseconds(anytimeDeadlineMS))) {
+				std::cout << "Stopped at the deadline with " << QH.getHullPoints().size() << " hull points, no input point more than "
+					<< QH.currentError() << " away from it" << std::endl;
+				complete = false;
+			}
+		}
+		else {
+			//no stepping needed when nothing is drawn, so the whole hull is computed at once
+			std::unique_ptr<Executor> executor = createExecutorForInput(executorType, QH.getBasePointList());
+			std::cout << "Computing hull with the " << executor->name() << " executor" << std::endl;
+			QH.computeHull(*executor);
+		}
+		if (cache && complete) {
+			cache->store(cacheKey, inputSize, orderHull(QH.getHullPoints()));
+		}
 	}
 	QH.outputHullPoints();
+	if (cache) {
+		cache->printReport();
+	}
+
+	TRACE_WRITE("trace.json");
+	PERF_REPORT();
+	MEMORY_REPORT("memory_profile.txt");
 #endif
 
 }
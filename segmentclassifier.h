@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+Precomputed line equations for side and distance tests.
+
+The determinant used to tell which side of a line a point is on, (x1 * y2) + (x3 * y1) + (x2 * y3) - (x3 * y2) - (x2 * y1) - (x1 * y3), takes six multiplies,
+but only two of them involve the point being tested. Rearranged, it's a * x3 + b * y3 + c, where a, b and c only depend on the line.
+A SegmentClassifier works those three out once per line, so every point after that costs two multiplies.
+
+The result is the same value the determinant gives: negative for points on the right of the line, positive on the left, and zero on it.
+Its size is also the point's distance from the line, scaled by the line's length, which is all the furthest point search needs.
+Everything is done in 64 bits, so it's exact for coordinates up to about a billion (2^30) either way.
+Points that come from outside the program (files, streams, sockets, shared memory) are checked against that with pointInRange() before they reach the engine,
+since past it the products overflow and the hull comes out quietly wrong.
+
+HullQuery builds one classifier per edge of a finished hull, to answer whether points are inside it.
+*/
+
+#include <vector>
+
+#include "point.h"
+
+//the largest coordinate, either way, that side() and the small kernels' turn test stay exact for
+const int pointCoordinateLimit = 1 << 30;
+
+constexpr bool pointInRange(Point p) {
+	return p.x >= -pointCoordinateLimit && p.x <= pointCoordinateLimit && p.y >= -pointCoordinateLimit && p.y <= pointCoordinateLimit;
+}
+
+struct SegmentClassifier {
+	long long a, b, c;
+
+	SegmentClassifier() : a(0), b(0), c(0) {}
+
+	SegmentClassifier(Point segmentA, Point segmentB) {
+		a = (long long)segmentA.y - segmentB.y;
+		b = (long long)segmentB.x - segmentA.x;
+		c = (long long)segmentA.x * segmentB.y - (long long)segmentB.x * segmentA.y;
+	}
+
+	//negative means the point is on the right of the line, positive on the left
+	long long side(Point p) const {
+		return a * p.x + b * p.y + c;
+	}
+
+	bool isRight(Point p) const {
+		return side(p) < 0;
+	}
+};
+
+//point-in-hull queries against a finished hull, given in order around the hull (either direction)
+class HullQuery {
+private:
+	std::vector<SegmentClassifier> edges;
+
+	//1 if the hull goes counterclockwise (inside is on the left of every edge), -1 if clockwise
+	long long orientation = 1;
+
+public:
+	HullQuery() {}
+
+	HullQuery(const std::vector<Point>& orderedHull) {
+		if (orderedHull.size() < 3) {
+			return;
+		}
+
+		//twice the signed area tells which way round the points go
+		long long area = 0;
+		for (size_t x = 0; x < orderedHull.size(); x++) {
+			const Point& current = orderedHull[x];
+			const Point& next = orderedHull[(x + 1) % orderedHull.size()];
+			area += (long long)current.x * next.y - (long long)next.x * current.y;
+		}
+		orientation = area < 0 ? -1 : 1;
+
+		edges.reserve(orderedHull.size());
+		for (size_t x = 0; x < orderedHull.size(); x++) {
+			edges.push_back(SegmentClassifier(orderedHull[x], orderedHull[(x + 1) % orderedHull.size()]));
+		}
+	}
+
+	bool empty() const {
+		return edges.empty();
+	}
+
+	//true if the point is inside the hull or on its boundary
+	bool contains(Point p) const {
+		if (edges.empty()) {
+			return false;
+		}
+		for (const SegmentClassifier& edge : edges) {
+			if (edge.side(p) * orientation < 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//true only if the point is inside and not on the boundary, meaning it can't be part of any hull that also contains this one
+	bool strictlyContains(Point p) const {
+		if (edges.empty()) {
+			return false;
+		}
+		for (const SegmentClassifier& edge : edges) {
+			if (edge.side(p) * orientation <= 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,417 @@
+#pragma once
+
+/*
+Shared-memory ingestion, for a producer on the same machine that makes points faster than they could be sent through a socket or a file.
+
+A SharedPointRing is a POSIX shared memory segment (shm_open) holding:
+	a single-producer, single-consumer ring of points. The producer only ever moves the head and the consumer only ever moves the tail,
+	so neither side takes a lock, and each keeps its own copy of the other's position so the shared ones are only read when the ring looks full or empty.
+	a snapshot of the current ordered hull, published with a seqlock: the writer bumps a sequence number to odd, writes, then bumps it back to even,
+	and readers copy the hull and retry if the sequence was odd or changed underneath them. Any number of processes can read it without ever blocking the writer.
+
+"--ring [name]" creates the segment and consumes it: points are folded into a RunningHull (see pointstream.h) in chunks,
+and the snapshot is republished after every chunk, until the producer closes the ring. Points with a coordinate past +-2^30 are dropped and counted.
+"--ring-produce [name] [points]" is a test producer that pushes random points, closes the ring, and prints the final hull from the snapshot on stdout.
+
+Only available where there's POSIX shared memory (Linux, macOS and other POSIX systems).
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "point.h"
+#include "segmentclassifier.h"
+#include "executor.h"
+#include "pointstream.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SHARED_RING_AVAILABLE 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define SHARED_RING_AVAILABLE 0
+#endif
+
+const char* const sharedRingDefaultName = "/quickhull_ring";
+
+const uint32_t sharedRingMagic = 0x474E5251; //'QRNG'
+const uint32_t sharedRingVersion = 1;
+
+//points in the ring (64 MB). has to be a power of two.
+const uint64_t sharedRingCapacity = 1 << 23;
+
+//most hull points the snapshot can hold. a bigger hull is published cut short, with truncated set.
+const uint32_t sharedRingSnapshotPoints = 1 << 16;
+
+//points the consumer gathers before folding them into the hull
+const size_t sharedRingChunkPoints = 1 << 20;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared ring needs lock-free 64-bit atomics to work across processes");
+
+//everything at the start of the segment. the positions are on their own cache lines, so the two sides don't keep stealing each other's line.
+struct SharedRingHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t capacity;
+	uint32_t snapshotCapacity;
+
+	alignas(64) std::atomic<uint64_t> head; //points written so far, only moved by the producer
+	alignas(64) std::atomic<uint64_t> tail; //points read so far, only moved by the consumer
+	alignas(64) std::atomic<uint32_t> producerClosed;
+	std::atomic<uint32_t> consumerFinished;
+
+	//the hull snapshot's seqlock. the points follow the header.
+	alignas(64) std::atomic<uint64_t> snapshotSequence;
+	std::atomic<uint32_t> snapshotCount;
+	std::atomic<uint32_t> snapshotTruncated;
+};
+
+#if SHARED_RING_AVAILABLE == 1
+
+class SharedPointRing {
+private:
+	std::string name;
+	bool owner = false;
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+
+	SharedRingHeader* header = nullptr;
+
+	//hull points packed into single words, so that reading them while they're being rewritten is a harmless (and detected) race rather than undefined behavior
+	std::atomic<uint64_t>* snapshot = nullptr;
+	Point* ring = nullptr;
+
+	//each side's last look at the other side's position
+	uint64_t cachedTail = 0;
+	uint64_t cachedHead = 0;
+
+	static size_t segmentSize(uint64_t capacity, uint32_t snapshotCapacity) {
+		return sizeof(SharedRingHeader) + snapshotCapacity * sizeof(uint64_t) + capacity * sizeof(Point);
+	}
+
+	bool mapSegment(int file, size_t size) {
+		mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		close(file);
+		if (mapping == MAP_FAILED) {
+			mapping = nullptr;
+			return false;
+		}
+		mappingSize = size;
+		header = (SharedRingHeader*)mapping;
+		return true;
+	}
+
+	void locateSections() {
+		snapshot = (std::atomic<uint64_t>*)((char*)mapping + sizeof(SharedRingHeader));
+		ring = (Point*)((char*)snapshot + header->snapshotCapacity * sizeof(uint64_t));
+	}
+
+	static uint64_t packPoint(Point p) {
+		return (uint64_t)(uint32_t)p.x | ((uint64_t)(uint32_t)p.y << 32);
+	}
+
+	static Point unpackPoint(uint64_t packed) {
+		return Point{ (int)(int32_t)(uint32_t)packed, (int)(int32_t)(uint32_t)(packed >> 32) };
+	}
+
+public:
+	SharedPointRing() {}
+	SharedPointRing(const SharedPointRing&) = delete;
+	SharedPointRing& operator=(const SharedPointRing&) = delete;
+
+	~SharedPointRing() {
+		if (mapping != nullptr) {
+			munmap(mapping, mappingSize);
+		}
+		if (owner) {
+			shm_unlink(name.c_str());
+		}
+	}
+
+	//creates a new segment (replacing any old one with the same name). the creator owns it, and removes it when done.
+	bool create(const std::string& segmentName, uint64_t capacity = sharedRingCapacity, uint32_t snapshotCapacity = sharedRingSnapshotPoints) {
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+			return false;
+		}
+		name = segmentName;
+		shm_unlink(name.c_str());
+		int file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (file < 0) {
+			return false;
+		}
+		owner = true;
+		size_t size = segmentSize(capacity, snapshotCapacity);
+		if (ftruncate(file, size) != 0) {
+			close(file);
+			return false;
+		}
+		if (!mapSegment(file, size)) {
+			return false;
+		}
+
+		//the new memory is all zeroes, so only the fixed fields need setting. the magic goes last, so a process attaching early doesn't see a half-made header.
+		new (header) SharedRingHeader();
+		header->version = sharedRingVersion;
+		header->capacity = capacity;
+		header->snapshotCapacity = snapshotCapacity;
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = sharedRingMagic;
+		locateSections();
+		return true;
+	}
+
+	//attaches to a segment made by create() in another process
+	bool open(const std::string& segmentName) {
+		name = segmentName;
+		int file = shm_open(name.c_str(), O_RDWR, 0600);
+		if (file < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) != 0 || (size_t)info.st_size < sizeof(SharedRingHeader)) {
+			close(file);
+			return false;
+		}
+		if (!mapSegment(file, (size_t)info.st_size)) {
+			return false;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->magic != sharedRingMagic || header->version != sharedRingVersion || header->capacity == 0 || (header->capacity & (header->capacity - 1)) != 0
+			|| segmentSize(header->capacity, header->snapshotCapacity) > mappingSize) {
+			munmap(mapping, mappingSize);
+			mapping = nullptr;
+			header = nullptr;
+			return false;
+		}
+		locateSections();
+		cachedHead = header->head.load(std::memory_order_acquire);
+		cachedTail = header->tail.load(std::memory_order_acquire);
+		return true;
+	}
+
+	//producer: writes as many of the points as there's room for, and returns how many that was
+	size_t tryPush(const Point* points, size_t count) {
+		uint64_t head = header->head.load(std::memory_order_relaxed);
+		uint64_t capacity = header->capacity;
+		if (head + count - cachedTail > capacity) {
+			cachedTail = header->tail.load(std::memory_order_acquire);
+		}
+		size_t room = (size_t)std::min<uint64_t>(count, capacity - (head - cachedTail));
+
+		//the free space might wrap around the end of the ring
+		size_t start = (size_t)(head & (capacity - 1));
+		size_t first = std::min<size_t>(room, capacity - start);
+		memcpy(ring + start, points, first * sizeof(Point));
+		memcpy(ring, points + first, (room - first) * sizeof(Point));
+
+		header->head.store(head + room, std::memory_order_release);
+		return room;
+	}
+
+	//producer: writes all the points, waiting for the consumer to make room when the ring is full
+	void push(const Point* points, size_t count) {
+		while (count > 0) {
+			size_t written = tryPush(points, count);
+			points += written;
+			count -= written;
+			if (written == 0) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	//producer: no more points are coming
+	void closeProducer() {
+		header->producerClosed.store(1, std::memory_order_release);
+	}
+
+	//consumer: takes up to maxCount points, returning how many there were
+	size_t pop(Point* out, size_t maxCount) {
+		uint64_t tail = header->tail.load(std::memory_order_relaxed);
+		if (cachedHead == tail) {
+			cachedHead = header->head.load(std::memory_order_acquire);
+		}
+		size_t available = (size_t)std::min<uint64_t>(maxCount, cachedHead - tail);
+		uint64_t capacity = header->capacity;
+
+		size_t start = (size_t)(tail & (capacity - 1));
+		size_t first = std::min<size_t>(available, capacity - start);
+		memcpy(out, ring + start, first * sizeof(Point));
+		memcpy(out + first, ring, (available - first) * sizeof(Point));
+
+		header->tail.store(tail + available, std::memory_order_release);
+		return available;
+	}
+
+	//consumer: true once the producer has closed the ring and everything in it has been taken
+	bool drained() {
+		if (header->producerClosed.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+		return header->head.load(std::memory_order_acquire) == header->tail.load(std::memory_order_relaxed);
+	}
+
+	//consumer: replaces the hull snapshot. only one process may publish.
+	void publishHull(const std::vector<Point>& ordered, bool final = false) {
+		uint32_t count = (uint32_t)std::min<size_t>(ordered.size(), header->snapshotCapacity);
+		uint64_t sequence = header->snapshotSequence.load(std::memory_order_relaxed);
+
+		//odd while it's being written. the fence keeps the point writes from being seen before the sequence change.
+		header->snapshotSequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (uint32_t x = 0; x < count; x++) {
+			snapshot[x].store(packPoint(ordered[x]), std::memory_order_relaxed);
+		}
+		header->snapshotCount.store(count, std::memory_order_relaxed);
+		header->snapshotTruncated.store(ordered.size() > count, std::memory_order_relaxed);
+		header->snapshotSequence.store(sequence + 2, std::memory_order_release);
+
+		if (final) {
+			header->consumerFinished.store(1, std::memory_order_release);
+		}
+	}
+
+	//anyone: copies the latest hull snapshot without locking, retrying if it changed while being copied.
+	//returns false if the hull was too big for the snapshot, in which case hull has the first part of it.
+	bool readHull(std::vector<Point>& hull) {
+		while (true) {
+			uint64_t before = header->snapshotSequence.load(std::memory_order_acquire);
+			if (before & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+			uint32_t count = std::min(header->snapshotCount.load(std::memory_order_relaxed), header->snapshotCapacity);
+			bool truncated = header->snapshotTruncated.load(std::memory_order_relaxed) != 0;
+			hull.resize(count);
+			for (uint32_t x = 0; x < count; x++) {
+				hull[x] = unpackPoint(snapshot[x].load(std::memory_order_relaxed));
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (header->snapshotSequence.load(std::memory_order_relaxed) == before) {
+				return !truncated;
+			}
+		}
+	}
+
+	//true once the consumer has published the hull of everything the producer sent
+	bool consumerFinished() {
+		return header->consumerFinished.load(std::memory_order_acquire) != 0;
+	}
+};
+
+//consumes the ring until the producer closes it, keeping the published hull up to date. returns false if the segment couldn't be made.
+inline bool runRingConsumer(Executor& exec, const std::string& name) {
+	SharedPointRing ring;
+	if (!ring.create(name)) {
+		return false;
+	}
+	printf("Consuming points from shared memory %s\n", name.c_str());
+	fflush(stdout);
+
+	RunningHull hull;
+	PointList chunk;
+	chunk.resize(sharedRingChunkPoints);
+	size_t chunkSize = 0;
+	size_t total = 0;
+	size_t outOfRange = 0;
+	while (true) {
+		size_t taken = ring.pop(chunk.data() + chunkSize, sharedRingChunkPoints - chunkSize);
+		total += taken;
+
+		//producers can push any int32, but the engine is only exact up to +-2^30 (see pointInRange() in segmentclassifier.h), so anything past that is dropped
+		Point* arrived = chunk.data() + chunkSize;
+		size_t kept = std::remove_if(arrived, arrived + taken, [](const Point& p) { return !pointInRange(p); }) - arrived;
+		outOfRange += taken - kept;
+		chunkSize += kept;
+
+		//fold in a full chunk, or whatever has arrived once the producer goes quiet, so the snapshot doesn't lag behind a slow producer
+		bool drained = taken == 0 && ring.drained();
+		if (chunkSize == sharedRingChunkPoints || (taken == 0 && chunkSize > 0)) {
+			chunk.resize(chunkSize);
+			hull.add(exec, chunk);
+			ring.publishHull(hull.ordered());
+			chunk.resize(sharedRingChunkPoints);
+			chunkSize = 0;
+			continue;
+		}
+		if (drained) {
+			break;
+		}
+		if (taken == 0) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+
+	std::vector<Point> ordered = hull.ordered();
+	ring.publishHull(ordered, true);
+	printf("Consumed %zu points, hull has %zu points\n", total, ordered.size());
+	if (outOfRange > 0) {
+		printf("Dropped %zu points with coordinates past +-2^30\n", outOfRange);
+	}
+
+	//give readers a moment to fetch the final hull before the segment goes away
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	return true;
+}
+
+//test producer: pushes random points into a ring made by runRingConsumer, then prints the final hull
+inline int runRingProducer(const std::string& name, size_t pointCount) {
+	SharedPointRing ring;
+	auto start = std::chrono::steady_clock::now();
+	while (!ring.open(name)) {
+		if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5)) {
+			printf("Error: No ring called %s (start the consumer with --ring first)\n", name.c_str());
+			return 1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+
+	start = std::chrono::steady_clock::now();
+	std::vector<Point> batch(4096);
+	unsigned int state = 1;
+	for (size_t sent = 0; sent < pointCount; sent += batch.size()) {
+		size_t count = std::min(batch.size(), pointCount - sent);
+		for (size_t x = 0; x < count; x++) {
+			state = state * 1664525u + 1013904223u;
+			batch[x].x = (state >> 8) % 1000000;
+			state = state * 1664525u + 1013904223u;
+			batch[x].y = (state >> 8) % 1000000;
+		}
+		ring.push(batch.data(), count);
+	}
+	ring.closeProducer();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "Pushed %zu points in %.3f s (%.1f million points/s)\n", pointCount, seconds, pointCount / seconds / 1e6);
+
+	while (!ring.consumerFinished()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	std::vector<Point> hull;
+	ring.readHull(hull);
+	writeHullPoints(stdout, hull);
+	return 0;
+}
+
+#else
+
+inline bool runRingConsumer(Executor&, const std::string&) {
+	printf("Error: Shared memory rings need POSIX shared memory, which isn't available on this platform\n");
+	return false;
+}
+
+inline int runRingProducer(const std::string&, size_t) {
+	printf("Error: Shared memory rings need POSIX shared memory, which isn't available on this platform\n");
+	return 1;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+
+/*
+Hull kernels for tiny point sets (32 points or fewer).
+
+For a handful of points, Quickhull spends nearly all of its time allocating vectors and sorting, not actually finding the hull.
+These kernels keep everything in fixed-size arrays on the stack instead, sort with a sorting network generated for the exact size,
+and then walk the sorted points with Andrew's monotone chain using branch-free orientation tests.
+
+Everything here is constexpr, so the hull of a constant set of points can be worked out at compile time, e.g.
+	constexpr SmallHullResult<4> square = smallHull<4>({ Point{0, 0}, Point{0, 5}, Point{5, 0}, Point{5, 5} });
+*/
+
+#include <array>
+#include <climits>
+
+#include "point.h"
+
+//anything bigger than this goes through the regular engine
+const int smallHullLimit = 32;
+
+template<int N>
+struct SmallHullResult {
+	Point points[N] = {};
+	int count = 0;
+};
+
+//packs a point into one integer with the same order as pointLessThan, so that comparisons are a single instruction
+constexpr long long smallHullSortKey(Point p) {
+	return ((long long)p.x << 32) | (long long)((unsigned int)p.y ^ 0x80000000u);
+}
+
+constexpr void smallHullCompareExchange(Point& a, Point& b) {
+	bool swap = smallHullSortKey(b) < smallHullSortKey(a);
+	Point low = swap ? b : a;
+	Point high = swap ? a : b;
+	a = low;
+	b = high;
+}
+
+//Batcher's odd-even merge sort. N is a power of two, so the compiler can lay out the whole network in advance.
+template<int N>
+constexpr void smallHullSortingNetwork(Point* points) {
+	static_assert((N & (N - 1)) == 0, "sorting network size has to be a power of two");
+	for (int p = 1; p < N; p += p) {
+		for (int k = p; k >= 1; k /= 2) {
+			for (int j = k % p; j <= N - 1 - k; j += 2 * k) {
+				for (int i = 0; i <= k - 1 && i <= N - j - k - 1; i++) {
+					if ((i + j) / (p * 2) == (i + j + k) / (p * 2)) {
+						smallHullCompareExchange(points[i + j], points[i + j + k]);
+					}
+				}
+			}
+		}
+	}
+}
+
+//sign of the turn a->b->c, as -1, 0 or 1, worked out without branching
+constexpr int smallHullTurn(Point a, Point b, Point c) {
+	long long cross = ((long long)b.x - a.x) * ((long long)c.y - a.y) - ((long long)b.y - a.y) * ((long long)c.x - a.x);
+	return (cross > 0) - (cross < 0);
+}
+
+//hull of up to N points. N has to be a power of two; unused slots are padded so they sort to the end and then dropped.
+template<int N>
+constexpr SmallHullResult<N> smallHull(const Point* input, int count) {
+	SmallHullResult<N> result;
+
+	Point sorted[N] = {};
+	for (int x = 0; x < N; x++) {
+		sorted[x] = x < count ? input[x] : Point{ INT_MAX, INT_MAX };
+	}
+	smallHullSortingNetwork<N>(sorted);
+
+	//drop duplicates. every point is written, but the write position only moves on for new ones.
+	int unique = count > 0 ? 1 : 0;
+	for (int x = 1; x < count; x++) {
+		sorted[unique] = sorted[x];
+		unique += !comparePoints(sorted[x], sorted[unique - 1]);
+	}
+
+	if (unique <= 2) {
+		for (int x = 0; x < unique; x++) {
+			result.points[x] = sorted[x];
+		}
+		result.count = unique;
+		return result;
+	}
+
+	//monotone chain: lower hull left-to-right, then upper hull right-to-left, popping anything that doesn't turn left
+	Point chain[2 * N] = {};
+	int k = 0;
+	for (int x = 0; x < unique; x++) {
+		while (k >= 2 && smallHullTurn(chain[k - 2], chain[k - 1], sorted[x]) <= 0) {
+			k--;
+		}
+		chain[k++] = sorted[x];
+	}
+	for (int x = unique - 2, lowerSize = k + 1; x >= 0; x--) {
+		while (k >= lowerSize && smallHullTurn(chain[k - 2], chain[k - 1], sorted[x]) <= 0) {
+			k--;
+		}
+		chain[k++] = sorted[x];
+	}
+
+	//the last point is the first one again
+	result.count = k - 1;
+	for (int x = 0; x < result.count; x++) {
+		result.points[x] = chain[x];
+	}
+	return result;
+}
+
+template<int N>
+constexpr SmallHullResult<N> smallHull(const std::array<Point, N>& input) {
+	return smallHull<N>(input.data(), N);
+}
+
+//picks the smallest kernel that fits and writes the hull into hullOut, which needs room for count points. returns the hull size.
+inline int smallHullPoints(const Point* points, int count, Point* hullOut) {
+	auto copyOut = [&](const auto& result) {
+		for (int x = 0; x < result.count; x++) {
+			hullOut[x] = result.points[x];
+		}
+		return result.count;
+	};
+
+	if (count <= 4) {
+		return copyOut(smallHull<4>(points, count));
+	}
+	if (count <= 8) {
+		return copyOut(smallHull<8>(points, count));
+	}
+	if (count <= 16) {
+		return copyOut(smallHull<16>(points, count));
+	}
+	return copyOut(smallHull<32>(points, count));
+}
+
+//compile-time check that the kernels really can run as constant expressions
+static_assert(smallHull<4>({ Point{ 0, 0 }, Point{ 0, 5 }, Point{ 5, 0 }, Point{ 5, 5 } }).count == 4, "constexpr small hull is broken");
+static_assert(smallHull<8>({ Point{ 0, 0 }, Point{ 4, 0 }, Point{ 2, 2 }, Point{ 4, 4 }, Point{ 0, 4 }, Point{ 1, 1 }, Point{ 2, 0 }, Point{ 2, 0 } }).count == 4, "constexpr small hull is broken");
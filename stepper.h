@@ -0,0 +1,235 @@
+#pragma once
+
+/*
+Coroutine version of the stepped algorithm.
+
+step() originally had to emulate recursion by hand (the StepData nodes and their StepDataProgress), since a normal recursive function can't be paused half-way.
+A C++20 coroutine can, so this is just the plain recursive Quickhull with a co_yield wherever a new hull point is found.
+Whoever is driving it gets one StepEvent per hull point, and can stop and draw in between (the visualizer) or simply run it to the end (everything else).
+
+Coroutine frames come out of a small free-list pool instead of the heap.
+The recursion only ever has one frame per level alive, so after the first descent nearly every frame is a reused one.
+*/
+
+#include <coroutine>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "point.h"
+#include "hullengine.h"
+
+//free blocks for coroutine frames, grouped by size rounded up to a cache line
+class CoroutineFramePool {
+private:
+	std::vector<std::vector<void*>> freeBlocks;
+
+public:
+	~CoroutineFramePool() {
+		for (std::vector<void*>& blocks : freeBlocks) {
+			for (void* block : blocks) {
+				::operator delete(block);
+			}
+		}
+	}
+
+	void* allocate(size_t size) {
+		size_t sizeClass = (size + 63) / 64;
+		if (sizeClass < freeBlocks.size() && !freeBlocks[sizeClass].empty()) {
+			void* block = freeBlocks[sizeClass].back();
+			freeBlocks[sizeClass].pop_back();
+			return block;
+		}
+		return ::operator new(sizeClass * 64);
+	}
+
+	void release(void* block, size_t size) {
+		size_t sizeClass = (size + 63) / 64;
+		if (sizeClass >= freeBlocks.size()) {
+			freeBlocks.resize(sizeClass + 1);
+		}
+		freeBlocks[sizeClass].push_back(block);
+	}
+};
+
+//one pool per thread, since frames are always created and destroyed by the thread driving the stepper
+inline CoroutineFramePool& coroutineFramePool() {
+	thread_local CoroutineFramePool pool;
+	return pool;
+}
+
+//what the stepper reports each time it finds a new hull point
+struct StepEvent {
+	Point furthest;
+
+	//first and last point of the subproblem the point was found in, drawn as the current pair
+	Point minPoint, maxPoint;
+
+	//the subproblem's points, and the two sets they were split into around furthest (everything else is inside the hull).
+	//used for coloring the points, and only valid until the next step.
+	const PointList* pointSet = nullptr;
+	const PointList* setOne = nullptr;
+	const PointList* setTwo = nullptr;
+};
+
+//generator of StepEvents that can co_yield another HullStepper, which then runs in place as if it were a nested call.
+//resuming always jumps straight to the innermost running coroutine, so a step costs the same no matter how deep the recursion is.
+class HullStepper {
+public:
+	struct promise_type {
+		const StepEvent* currentEvent = nullptr;
+
+		//the outermost coroutine, the innermost one currently running, and the one that co_yielded this one
+		promise_type* root = this;
+		promise_type* leaf = this;
+		promise_type* parent = nullptr;
+
+		static void* operator new(size_t size) {
+			return coroutineFramePool().allocate(size);
+		}
+
+		static void operator delete(void* block, size_t size) {
+			coroutineFramePool().release(block, size);
+		}
+
+		HullStepper get_return_object() {
+			return HullStepper(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		//when a nested stepper finishes, hand control straight back to whoever yielded it
+		struct FinalAwaiter {
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> finished) noexcept {
+				promise_type& promise = finished.promise();
+				if (promise.parent == nullptr) {
+					return std::noop_coroutine();
+				}
+				promise.root->leaf = promise.parent;
+				return std::coroutine_handle<promise_type>::from_promise(*promise.parent);
+			}
+			void await_resume() noexcept {}
+		};
+		FinalAwaiter final_suspend() noexcept { return {}; }
+
+		std::suspend_always yield_value(const StepEvent& event) {
+			root->currentEvent = &event;
+			return {};
+		}
+
+		//yielding another stepper runs it to completion before this one continues.
+		//the awaiter owns the nested coroutine, so it's cleaned up along with this frame even if stepping stops early.
+		struct NestedAwaiter {
+			std::coroutine_handle<promise_type> nested;
+
+			NestedAwaiter(std::coroutine_handle<promise_type> nestedHandle) : nested(nestedHandle) {}
+			NestedAwaiter(NestedAwaiter&& other) noexcept : nested(std::exchange(other.nested, nullptr)) {}
+			~NestedAwaiter() {
+				if (nested) {
+					nested.destroy();
+				}
+			}
+
+			bool await_ready() noexcept { return !nested; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> current) noexcept {
+				promise_type& parentPromise = current.promise();
+				promise_type& nestedPromise = nested.promise();
+				nestedPromise.root = parentPromise.root;
+				nestedPromise.parent = &parentPromise;
+				parentPromise.root->leaf = &nestedPromise;
+				return nested;
+			}
+			void await_resume() noexcept {}
+		};
+		NestedAwaiter yield_value(HullStepper&& nested) {
+			return NestedAwaiter(std::exchange(nested.handle, nullptr));
+		}
+
+		void return_void() {}
+		void unhandled_exception() { throw; }
+	};
+
+	HullStepper() {}
+
+	HullStepper(HullStepper&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+	HullStepper& operator=(HullStepper&& other) noexcept {
+		if (this != &other) {
+			if (handle) {
+				handle.destroy();
+			}
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+
+	~HullStepper() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	//runs until the next hull point is found. returns false once the hull is complete.
+	bool next() {
+		if (!handle || handle.done()) {
+			return false;
+		}
+		std::coroutine_handle<promise_type>::from_promise(*handle.promise().leaf).resume();
+		return !handle.done();
+	}
+
+	//the event from the last successful call to next()
+	const StepEvent& event() const {
+		return *handle.promise().currentEvent;
+	}
+
+private:
+	explicit HullStepper(std::coroutine_handle<promise_type> newHandle) : handle(newHandle) {}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+//the recursion itself. furthest was already found while splitting the parent.
+//subproblems are visited in the same order step() visits them: the C->B side first, then A->C.
+inline HullStepper stepHull(Executor& exec, PointList pointSet, Point segmentA, Point segmentB, Point furthest) {
+	if (pointSet.empty()) {
+		co_return;
+	}
+
+	//split before reporting the step, so whoever is drawing it can see where every point went
+	PointList setOne, setTwo;
+	Point furthestOne, furthestTwo;
+	partitionAroundPoint(exec, segmentA, segmentB, furthest, pointSet, setOne, setTwo, furthestOne, furthestTwo);
+
+	StepEvent event;
+	event.furthest = furthest;
+	event.minPoint = pointSet[0];
+	event.maxPoint = pointSet[pointSet.size() - 1];
+	event.pointSet = &pointSet;
+	event.setOne = &setOne;
+	event.setTwo = &setTwo;
+	co_yield event;
+	pointSet = PointList();
+
+	co_yield stepHull(exec, std::move(setTwo), furthest, segmentB, furthestTwo);
+	co_yield stepHull(exec, std::move(setOne), segmentA, furthest, furthestOne);
+}
+
+//steps through the whole hull of a list sorted with pointLessThan. the leftmost and rightmost points aren't reported, since they're known before the first step.
+inline HullStepper stepHullFromStart(Executor& exec, PointList sortedPoints) {
+	if (sortedPoints.empty()) {
+		co_return;
+	}
+
+	Point minPoint = sortedPoints[0];
+	Point maxPoint = sortedPoints[sortedPoints.size() - 1];
+
+	PointList upperSet, lowerSet;
+	Point upperFurthest, lowerFurthest;
+	partitionAroundPoint(exec, minPoint, minPoint, maxPoint, sortedPoints, upperSet, lowerSet, upperFurthest, lowerFurthest);
+	sortedPoints = PointList();
+
+	co_yield stepHull(exec, std::move(lowerSet), maxPoint, minPoint, lowerFurthest);
+	co_yield stepHull(exec, std::move(upperSet), minPoint, maxPoint, upperFurthest);
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+/*
+Tiled hulls: a way to spread the hull across threads that doesn't depend on how evenly Quickhull's recursion splits.
+
+The engine's parallelism comes from the two halves of every split, so when the first split (SDP_FirstIteration) leaves nearly every point on one side,
+half the threads have nothing to do. Tiling splits the work up by area instead:
+	the bounding box is cut into a grid of tiles, and every point is counted into its tile,
+	any tile that has points in tiles to its lower left, lower right, upper left and upper right is dropped without looking at its points again,
+	the points of the tiles that are left are gathered up and each tile's hull is worked out on its own, spread over the executor,
+	and the hull of all those tile hulls together is the hull of the whole input.
+
+A tile can be dropped because any point with other points in all four of its diagonal quadrants is strictly inside their hull (a line through it that had them all on one side would have to leave a whole quadrant on the other).
+So dropped points can't be on the hull, not even as collinear points along an edge. Which tiles have points in each quadrant comes from four prefix-OR tables over the grid,
+so for evenly spread points all but a ring of tiles around the edge is thrown away after a single counting pass.
+*/
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "point.h"
+#include "executor.h"
+#include "hullengine.h"
+
+//points per tile the grid aims for, and the most tiles along each side
+const size_t tiledHullTilePoints = 1024;
+const size_t tiledHullMaxTilesPerSide = 128;
+
+//inputs smaller than this go straight to the engine, since there's nothing to gain from tiling them
+const size_t tiledHullMinPoints = 65536;
+
+struct TiledHullStats {
+	size_t tiles = 0;
+	size_t keptTiles = 0;
+	size_t keptPoints = 0;
+};
+
+//computes the hull of the points, which can be in any order, by tiles. the hull points come back unordered, same as computeHullPoints.
+inline std::vector<Point> computeTiledHull(Executor& exec, const PointList& points, TiledHullStats* stats = nullptr) {
+	size_t count = points.size();
+	if (count < tiledHullMinPoints) {
+		PointList sorted = points;
+		std::sort(sorted.begin(), sorted.end(), pointLessThan);
+		if (stats) {
+			*stats = { 1, 1, count };
+		}
+		return computeHullPoints(exec, sorted);
+	}
+
+	//bounding box
+	size_t chunks = exec.chunkCount(count, engineGrainSize);
+	std::vector<Point> chunkMin(chunks), chunkMax(chunks);
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			chunkBounds(count, chunks, chunk, begin, end);
+			Point low = points[begin], high = points[begin];
+			for (size_t x = begin; x < end; x++) {
+				low.x = std::min(low.x, points[x].x);
+				low.y = std::min(low.y, points[x].y);
+				high.x = std::max(high.x, points[x].x);
+				high.y = std::max(high.y, points[x].y);
+			}
+			chunkMin[chunk] = low;
+			chunkMax[chunk] = high;
+		}
+		});
+	Point low = chunkMin[0], high = chunkMax[0];
+	for (size_t chunk = 1; chunk < chunks; chunk++) {
+		low.x = std::min(low.x, chunkMin[chunk].x);
+		low.y = std::min(low.y, chunkMin[chunk].y);
+		high.x = std::max(high.x, chunkMax[chunk].x);
+		high.y = std::max(high.y, chunkMax[chunk].y);
+	}
+
+	//a square grid, with tiles covering [low, high] in whole coordinates
+	size_t side = 1;
+	while (side < tiledHullMaxTilesPerSide && side * side * tiledHullTilePoints < count) {
+		side++;
+	}
+	size_t tiles = side * side;
+	int64_t tileWidth = ((int64_t)high.x - low.x) / (int64_t)side + 1;
+	int64_t tileHeight = ((int64_t)high.y - low.y) / (int64_t)side + 1;
+	auto tileOf = [&](const Point& p) {
+		return (size_t)(((int64_t)p.y - low.y) / tileHeight) * side + (size_t)(((int64_t)p.x - low.x) / tileWidth);
+	};
+
+	//points per tile, per chunk
+	std::vector<uint32_t> counts(chunks * tiles, 0);
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			chunkBounds(count, chunks, chunk, begin, end);
+			uint32_t* chunkCounts = &counts[chunk * tiles];
+			for (size_t x = begin; x < end; x++) {
+				chunkCounts[tileOf(points[x])]++;
+			}
+		}
+		});
+	std::vector<uint8_t> occupied(tiles, 0);
+	for (size_t chunk = 0; chunk < chunks; chunk++) {
+		for (size_t tile = 0; tile < tiles; tile++) {
+			occupied[tile] |= counts[chunk * tiles + tile] != 0;
+		}
+	}
+
+	//for each corner, whether some occupied tile lies strictly beyond that corner of each tile (nothing does for tiles on the grid's edges on that side).
+	//filled like a prefix sum, starting from that corner of the grid: the tile diagonally before, or anything beyond either of its neighbors towards the corner.
+	std::vector<uint8_t> keep(tiles, 0);
+	std::vector<uint8_t> beyond(tiles);
+	std::vector<uint8_t> surrounded(tiles, 1);
+	for (int corner = 0; corner < 4; corner++) {
+		bool flipX = corner & 1, flipY = corner & 2;
+		for (size_t row = 0; row < side; row++) {
+			for (size_t column = 0; column < side; column++) {
+				size_t tileX = flipX ? side - 1 - column : column;
+				size_t tileY = flipY ? side - 1 - row : row;
+				size_t previousX = flipX ? tileX + 1 : tileX - 1;
+				size_t previousY = flipY ? tileY + 1 : tileY - 1;
+				uint8_t found = 0;
+				if (row > 0 && column > 0) {
+					found = occupied[previousY * side + previousX] | beyond[previousY * side + tileX] | beyond[tileY * side + previousX];
+				}
+				beyond[tileY * side + tileX] = found;
+			}
+		}
+		for (size_t tile = 0; tile < tiles; tile++) {
+			surrounded[tile] &= beyond[tile];
+		}
+	}
+
+	//the tiles that are left, and where each chunk writes its points of each of them
+	std::vector<size_t> keptTiles;
+	for (size_t tile = 0; tile < tiles; tile++) {
+		if (occupied[tile] && !surrounded[tile]) {
+			keep[tile] = 1;
+			keptTiles.push_back(tile);
+		}
+	}
+	std::vector<size_t> offsets(chunks * tiles, 0);
+	std::vector<size_t> tileStarts(keptTiles.size() + 1);
+	size_t total = 0;
+	for (size_t kept = 0; kept < keptTiles.size(); kept++) {
+		tileStarts[kept] = total;
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			offsets[chunk * tiles + keptTiles[kept]] = total;
+			total += counts[chunk * tiles + keptTiles[kept]];
+		}
+	}
+	tileStarts[keptTiles.size()] = total;
+
+	std::vector<Point> gathered(total);
+	exec.parallelFor(chunks, [&](size_t chunkBegin, size_t chunkEnd) {
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+			size_t begin, end;
+			chunkBounds(count, chunks, chunk, begin, end);
+			size_t* chunkOffsets = &offsets[chunk * tiles];
+			for (size_t x = begin; x < end; x++) {
+				size_t tile = tileOf(points[x]);
+				if (keep[tile]) {
+					gathered[chunkOffsets[tile]++] = points[x];
+				}
+			}
+		}
+		});
+
+	//each tile's hull on its own thread
+	std::vector<std::vector<Point>> tileHulls(keptTiles.size());
+	exec.parallelFor(keptTiles.size(), [&](size_t begin, size_t end) {
+		SequentialExecutor inner;
+		for (size_t kept = begin; kept < end; kept++) {
+			PointList tilePoints(gathered.begin() + tileStarts[kept], gathered.begin() + tileStarts[kept + 1]);
+			std::sort(tilePoints.begin(), tilePoints.end(), pointLessThan);
+			tileHulls[kept] = computeHullPoints(inner, tilePoints);
+		}
+		});
+
+	//every point of the hull is on its own tile's hull, so the hull of those is the answer
+	PointList merged;
+	for (const std::vector<Point>& hull : tileHulls) {
+		merged.insert(merged.end(), hull.begin(), hull.end());
+	}
+	std::sort(merged.begin(), merged.end(), pointLessThan);
+
+	if (stats) {
+		*stats = { tiles, keptTiles.size(), total };
+	}
+	return computeHullPoints(exec, merged);
+}
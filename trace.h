@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+Per-phase timers, written out as a Chrome trace file.
+
+Wrapping a block in TRACE_SCOPE("name") records how long it took, along with which thread ran it.
+At the end of the run the events are saved as trace.json, which can be opened in chrome://tracing or https://ui.perfetto.dev.
+Every thread that recorded something gets its own track, so work spread out by the executors shows up side by side.
+
+Turned on with ENABLE_TRACING in quickhull.cpp. When it's off, TRACE_SCOPE and TRACE_WRITE expand to nothing at all.
+*/
+
+#ifndef ENABLE_TRACING
+#define ENABLE_TRACING 0
+#endif
+
+#if ENABLE_TRACING == 1
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+
+struct TraceEvent {
+	const char* name;
+	long long startNanos;
+	long long durationNanos;
+};
+
+//each thread records into its own buffer, so recording never has to take a lock
+struct TraceThreadBuffer {
+	int threadId;
+	std::vector<TraceEvent> events;
+};
+
+class Tracer {
+private:
+	std::mutex bufferLock;
+	std::vector<std::unique_ptr<TraceThreadBuffer>> buffers;
+	std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+	TraceThreadBuffer& threadBuffer() {
+		thread_local TraceThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr) {
+			std::lock_guard<std::mutex> lock(bufferLock);
+			buffers.push_back(std::make_unique<TraceThreadBuffer>());
+			buffer = buffers.back().get();
+			buffer->threadId = (int)buffers.size();
+		}
+		return *buffer;
+	}
+
+public:
+	long long now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+	}
+
+	void record(const char* name, long long startNanos, long long endNanos) {
+		threadBuffer().events.push_back(TraceEvent{ name, startNanos, endNanos - startNanos });
+	}
+
+	//saves everything recorded so far. should be called once the other threads have finished their work.
+	bool writeTrace(const char* path) {
+		FILE* file = fopen(path, "w");
+		if (file == nullptr) {
+			printf("Error: Unable to create trace file %s!\n", path);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(bufferLock);
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		bool first = true;
+		for (const std::unique_ptr<TraceThreadBuffer>& buffer : buffers) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+				first ? "" : ",\n", buffer->threadId, buffer->threadId == 1 ? "main thread" : "worker", buffer->threadId);
+			first = false;
+
+			//timestamps are in microseconds, but fractions are allowed
+			for (const TraceEvent& event : buffer->events) {
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, buffer->threadId, event.startNanos / 1000.0, event.durationNanos / 1000.0);
+			}
+		}
+		fprintf(file, "\n]}\n");
+		fclose(file);
+		return true;
+	}
+};
+
+inline Tracer& tracer() {
+	static Tracer instance;
+	return instance;
+}
+
+//records the time between its creation and the end of the enclosing block
+class TraceScope {
+private:
+	const char* name;
+	long long start;
+
+public:
+	TraceScope(const char* scopeName) : name(scopeName), start(tracer().now()) {}
+
+	~TraceScope() {
+		tracer().record(name, start, tracer().now());
+	}
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_WRITE(path) tracer().writeTrace(path)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_WRITE(path)
+
+#endif